@@ -0,0 +1,680 @@
+#include "compiler.hpp"
+
+using namespace pop;
+
+// marks instructions that can not raise errors
+#define NO_SITE 0xFFFFFFFF
+
+#pragma region Helpers
+
+/**
+ * The instruction of a binary operator statement.
+*/
+static OpCode binary_op_code(StatementType type)
+{
+    switch (type)
+    {
+    case StatementType::ADD_OP: return OpCode::ADD;
+    case StatementType::SUB_OP: return OpCode::SUB;
+    case StatementType::MULT_OP: return OpCode::MULT;
+    case StatementType::DIV_OP: return OpCode::DIV;
+    case StatementType::MOD_OP: return OpCode::MOD;
+    case StatementType::EQUALS_OP: return OpCode::EQUALS;
+    case StatementType::NEQUALS_OP: return OpCode::NEQUALS;
+    case StatementType::GTHANE_OP: return OpCode::GTHANE;
+    case StatementType::LTHANE_OP: return OpCode::LTHANE;
+    case StatementType::GTHAN_OP: return OpCode::GTHAN;
+    case StatementType::LTHAN_OP: return OpCode::LTHAN;
+    default: return OpCode::ADD;
+    }
+}
+
+#pragma endregion
+
+#pragma region Private Methods
+
+/**
+ * Appends an instruction to the current chunk.
+*/
+unsigned int Compiler::emit(OpCode op, unsigned int a, unsigned int b, unsigned int c)
+{
+    Instruction instruction;
+    instruction.op = op;
+    instruction.a = CAST(a, unsigned short);
+    instruction.b = CAST(b, unsigned short);
+    instruction.c = CAST(c, unsigned short);
+
+    chunk->code.push_back(instruction);
+    chunk->sites.push_back(site);
+
+    return chunk->code.size() - 1;
+}
+
+/**
+ * Appends an instruction with a 32 bit operand to the current chunk.
+*/
+unsigned int Compiler::emit_bx(OpCode op, unsigned int a, unsigned int bx)
+{
+    return emit(op, a, bx & 0xFFFF, bx >> 16);
+}
+
+/**
+ * Points the 32 bit operand of a jump at the target.
+*/
+void Compiler::patch(unsigned int instruction, unsigned int target)
+{
+    chunk->code[instruction].b = CAST(target & 0xFFFF, unsigned short);
+    chunk->code[instruction].c = CAST(target >> 16, unsigned short);
+}
+
+/**
+ * The index of the next instruction.
+*/
+unsigned int Compiler::here() const
+{
+    return chunk->code.size();
+}
+
+unsigned int Compiler::add_constant(const Object& constant)
+{
+    chunk->constants.push_back(constant);
+    return chunk->constants.size() - 1;
+}
+
+/**
+ * Adds a name to the current chunk, reusing names that already exist.
+*/
+unsigned int Compiler::add_name(Symbol name)
+{
+    for (unsigned int i = 0; i < chunk->names.size(); ++i)
+    {
+        if (chunk->names[i] == name)
+            return i;
+    }
+
+    chunk->names.push_back(name);
+    return chunk->names.size() - 1;
+}
+
+/**
+ * Adds a declaration of a variable to the current chunk.
+*/
+unsigned int Compiler::add_declaration(unsigned int slot, Symbol name)
+{
+    chunk->declarations.push_back({ slot, name });
+    return chunk->declarations.size() - 1;
+}
+
+/**
+ * Starts a new error site, the resume point is patched by the caller.
+*/
+unsigned int Compiler::push_site(const Statement& statement, int nilRegister)
+{
+    Site newSite;
+    newSite.statement = &statement;
+    newSite.resume = 0;
+    newSite.nilRegister = nilRegister;
+
+    chunk->siteTable.push_back(newSite);
+    site = chunk->siteTable.size() - 1;
+
+    return site;
+}
+
+unsigned int Compiler::allocate_register()
+{
+    unsigned int reg = registerTop++;
+
+    if (registerTop > chunk->registerCount)
+        chunk->registerCount = registerTop;
+
+    return reg;
+}
+
+/**
+ * Compiles a function into its own chunk.
+*/
+void Compiler::compile_function(Statement& function)
+{
+    SI_Function* siFunction = static_cast<SI_Function*>(function.info);
+
+    // save the state of the enclosing chunk
+    Chunk* enclosingChunk = chunk;
+    unsigned int enclosingRegisterTop = registerTop;
+    unsigned int enclosingScopeDepth = scopeDepth;
+    unsigned int enclosingSite = site;
+    bool enclosingLoopChunk = loopChunk;
+    std::vector<Loop> enclosingLoops;
+    enclosingLoops.swap(loops);
+
+    Chunk functionChunk;
+    functionChunk.name = SymbolTable::global().get_name(siFunction->functionName);
+    functionChunk.parameterNames = siFunction->parameterNames;
+    functionChunk.function = &function;
+    functionChunk.memoized = siFunction->memoized;
+
+    chunk = &functionChunk;
+    registerTop = 0;
+    scopeDepth = 0;
+    site = NO_SITE;
+    loopChunk = false;
+
+    compile_block(function.children()[0]);
+    emit(OpCode::RETURN_NIL);
+
+    program.chunks.push_back(std::move(functionChunk));
+    program.functions[&function] = program.chunks.size() - 1;
+
+    chunk = enclosingChunk;
+    registerTop = enclosingRegisterTop;
+    scopeDepth = enclosingScopeDepth;
+    site = enclosingSite;
+    loopChunk = enclosingLoopChunk;
+    loops.swap(enclosingLoops);
+}
+
+/**
+ * Compiles a block of statements, in its own scope if it needs one.
+ * After every statement the block is left if an error was reported.
+*/
+void Compiler::compile_block(Statement& block)
+{
+    bool scoped = static_cast<SI_Block*>(block.info)->scoped;
+
+    if (scoped)
+    {
+        chunk->blocks.push_back(&block);
+        emit_bx(OpCode::ENTER_SCOPE, 0, chunk->blocks.size() - 1);
+        ++scopeDepth;
+    }
+
+    std::vector<unsigned int> errorJumps;
+
+    for (auto& statement : block.children())
+    {
+        if (statement.type == StatementType::FUNCTION)
+        {
+            if (program.functions.count(&statement) == 0)
+                compile_function(statement);
+
+            continue;
+        }
+
+        compile_statement(statement);
+
+        if (statement.type != StatementType::BREAK && statement.type != StatementType::CONTINUE)
+            errorJumps.push_back(emit_bx(OpCode::JUMP_IF_ERROR, 0, 0));
+    }
+
+    for (auto& jump : errorJumps)
+        patch(jump, here());
+
+    if (scoped)
+    {
+        emit(OpCode::LEAVE_SCOPE, 1);
+        --scopeDepth;
+    }
+}
+
+/**
+ * Compiles a single statement.
+*/
+void Compiler::compile_statement(Statement& statement)
+{
+    registerTop = 0;
+
+    // ASSIGNMENT STATEMENT
+    if (statement.type == StatementType::ASSIGN)
+    {
+        SI_Variable* siAssign = static_cast<SI_Variable*>(statement.info);
+
+        unsigned int statementSite = push_site(statement);
+        unsigned int value = allocate_register();
+        compile_expression(statement.children()[0], value);
+
+        if (siAssign->byName)
+            emit_bx(OpCode::SET_VAR, value, add_declaration(siAssign->slot, siAssign->symbol));
+        else if (siAssign->declaration)
+            emit_bx(OpCode::DECLARE, value, add_declaration(siAssign->slot, siAssign->symbol));
+        else
+            emit_bx(OpCode::SET_LOCAL, value, siAssign->slot);
+
+        chunk->siteTable[statementSite].resume = here();
+        site = NO_SITE;
+    }
+    // IF STATEMENT
+    else if (statement.type == StatementType::IF)
+    {
+        unsigned int statementSite = push_site(statement);
+        unsigned int condition = allocate_register();
+        compile_expression(statement.children()[0], condition);
+        unsigned int jumpToElse = emit_bx(OpCode::JUMP_IF_FALSE, condition, 0);
+        site = NO_SITE;
+
+        compile_block(statement.children()[1]);
+
+        if (statement.children().size() == 3)
+        {
+            unsigned int jumpToEnd = emit_bx(OpCode::JUMP, 0, 0);
+            patch(jumpToElse, here());
+
+            compile_statement(statement.children()[2]);
+
+            patch(jumpToEnd, here());
+        }
+        else
+        {
+            patch(jumpToElse, here());
+        }
+
+        chunk->siteTable[statementSite].resume = here();
+    }
+    // ELSE STATEMENT
+    else if (statement.type == StatementType::ELSE)
+    {
+        compile_block(statement.children()[0]);
+    }
+    // WHILE STATEMENT
+    else if (statement.type == StatementType::WHILE)
+    {
+        // a loop with invariants runs under a stamp of its own
+        SI_Loop* siLoop = static_cast<SI_Loop*>(statement.info);
+
+        if (siLoop != nullptr)
+        {
+            chunk->loops.push_back(siLoop);
+            emit_bx(OpCode::ENTER_LOOP, 0, chunk->loops.size() - 1);
+        }
+
+        Loop loop;
+        loop.start = here();
+        loop.scopeDepth = scopeDepth;
+
+        unsigned int statementSite = push_site(statement);
+        unsigned int condition = allocate_register();
+        compile_expression(statement.children()[0], condition);
+        unsigned int jumpToEnd = emit_bx(OpCode::JUMP_IF_FALSE, condition, 0);
+        site = NO_SITE;
+
+        loops.push_back(loop);
+        compile_block(statement.children()[1]);
+        emit_bx(OpCode::JUMP, 0, loop.start);
+
+        patch(jumpToEnd, here());
+
+        for (auto& jump : loops.back().breaks)
+            patch(jump, here());
+
+        loops.pop_back();
+
+        chunk->siteTable[statementSite].resume = here();
+
+        if (siLoop != nullptr)
+            emit(OpCode::LEAVE_LOOP);
+    }
+    // FUNCTION CALL STATEMENT
+    else if (statement.type == StatementType::FUNCTION_CALL)
+    {
+        unsigned int statementSite = push_site(statement);
+        compile_function_call(statement, allocate_register());
+
+        chunk->siteTable[statementSite].resume = here();
+        site = NO_SITE;
+    }
+    // RETURN STATEMENT
+    else if (statement.type == StatementType::RETURN)
+    {
+        unsigned int statementSite = push_site(statement);
+        unsigned int value = allocate_register();
+
+        const Statement* returned = &statement.children()[0];
+
+        while (returned->type == StatementType::EXP)
+            returned = &returned->children()[0];
+
+        // a loop chunk has no frame of its own to hand to the callee
+        if (returned->type == StatementType::FUNCTION_CALL && static_cast<SI_FunctionCall*>(returned->info)->tail && !loopChunk)
+            compile_function_call(*returned, value, true);
+        else
+            compile_expression(statement.children()[0], value);
+
+        emit(OpCode::RETURN, value);
+
+        chunk->siteTable[statementSite].resume = here();
+        site = NO_SITE;
+    }
+    // BREAK STATEMENT
+    else if (statement.type == StatementType::BREAK)
+    {
+        compile_leave_scopes(loops.back().scopeDepth);
+        loops.back().breaks.push_back(emit_bx(OpCode::JUMP, 0, 0));
+    }
+    // CONTINUE STATEMENT
+    else if (statement.type == StatementType::CONTINUE)
+    {
+        compile_leave_scopes(loops.back().scopeDepth);
+        emit_bx(OpCode::JUMP, 0, loops.back().start);
+    }
+}
+
+/**
+ * Leaves every scope entered since the given depth.
+*/
+void Compiler::compile_leave_scopes(unsigned int depth)
+{
+    if (scopeDepth > depth)
+        emit(OpCode::LEAVE_SCOPE, scopeDepth - depth);
+}
+
+/**
+ * Compiles an expression into the target register.
+*/
+void Compiler::compile_expression(const Statement& statement, unsigned int target)
+{
+    if (is_binary_operator(statement.type))
+    {
+        compile_operators(statement, target);
+        return;
+    }
+
+    switch (statement.type)
+    {
+    case StatementType::FUNCTION_CALL:
+        compile_function_call(statement, target);
+        return;
+    case StatementType::EXP:
+        compile_expression(statement.children()[0], target);
+        return;
+    case StatementType::INVARIANT:
+        if (SI_Invariant* siInvariant = static_cast<SI_Invariant*>(statement.info))
+        {
+            // computed once under the stamp of its loop
+            unsigned int index = chunk->invariants.size();
+            chunk->invariants.push_back({ siInvariant, 0 });
+
+            emit_bx(OpCode::LOAD_INVARIANT, target, index);
+            compile_expression(statement.children()[0], target);
+            emit_bx(OpCode::STORE_INVARIANT, target, index);
+
+            chunk->invariants[index].skip = here();
+        }
+        else
+        {
+            compile_expression(statement.children()[0], target);
+        }
+        return;
+    case StatementType::INLINE:
+        {
+            // an inlined function reports its errors where it returns
+            unsigned int enclosingSite = site;
+            unsigned int inlineSite = push_site(statement, target);
+            compile_expression(statement.children()[0], target);
+            chunk->siteTable[inlineSite].resume = here();
+            site = enclosingSite;
+        }
+        return;
+    case StatementType::CONSTANT:
+        {
+            SI_Constant* siConstant = static_cast<SI_Constant*>(statement.info);
+            emit_bx(OpCode::LOAD_CONST, target, add_constant(siConstant->value));
+        }
+        return;
+    case StatementType::STRING:
+        {
+            SI_String* siString = static_cast<SI_String*>(statement.info);
+            emit_bx(OpCode::LOAD_CONST, target, add_constant(Object::make_string(siString->value)));
+        }
+        return;
+    case StatementType::BOOLEAN:
+        {
+            SI_Boolean* siBoolean = static_cast<SI_Boolean*>(statement.info);
+            emit_bx(OpCode::LOAD_CONST, target, add_constant(Object::make_bool(siBoolean->value)));
+        }
+        return;
+    case StatementType::VARIABLE:
+        {
+            SI_Variable* siVariable = static_cast<SI_Variable*>(statement.info);
+
+            if (siVariable->slot >= 0)
+                emit_bx(OpCode::GET_LOCAL, target, siVariable->slot);
+            else
+                emit_bx(OpCode::GET_VAR, target, add_name(siVariable->symbol));
+        }
+        return;
+    case StatementType::NUMBER:
+        {
+            SI_String* siNumber = static_cast<SI_String*>(statement.info);
+
+            try
+            {
+                if (siNumber->value.find('.') != std::string::npos)
+                    emit_bx(OpCode::LOAD_CONST, target, add_constant(Object::make_float32(std::stof(siNumber->value))));
+                else
+                    emit_bx(OpCode::LOAD_CONST, target, add_constant(Object::make_int32(std::stoi(siNumber->value))));
+            }
+            catch (const std::exception& exp)
+            {
+                // the number does not fit, report it when it is evaluated
+                emit_bx(OpCode::RAISE, target, add_constant(Object::make_string(exp.what())));
+            }
+        }
+        return;
+    case StatementType::CHAR:
+        {
+            SI_String* siChar = static_cast<SI_String*>(statement.info);
+            emit_bx(OpCode::LOAD_CONST, target, add_constant(Object::make_char(siChar->value[0])));
+        }
+        return;
+    case StatementType::NEGATE_OP:
+        compile_expression(statement.children()[0], target);
+        emit(OpCode::NEGATE, target, target);
+        return;
+    default:
+        emit(OpCode::LOAD_NIL, target);
+        return;
+    }
+}
+
+/**
+ * Compiles a chain of operators into the target register, from its
+ * first operand up. Every operator applies its second operand in place.
+*/
+void Compiler::compile_operators(const Statement& chain, unsigned int target)
+{
+    std::vector<const Statement*> operators;
+    compile_expression(collect_operator_chain(chain, operators), target);
+
+    for (auto op = operators.rbegin(); op != operators.rend(); ++op)
+    {
+        unsigned int right = allocate_register();
+        compile_expression((*op)->children()[1], right);
+        emit(binary_op_code((*op)->type), target, target, right);
+
+        registerTop = right;
+    }
+}
+
+/**
+ * Compiles a call to a native or a user function into the target register.
+ * A tail call does not come back, the target only gets nil if it fails.
+*/
+void Compiler::compile_function_call(const Statement& functionCall, unsigned int target, bool tail)
+{
+    SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(functionCall.info);
+
+    // NATIVE FUNCTIONS
+    if (siFunctionCall->native >= 0)
+    {
+        compile_native_call(functionCall, siFunctionCall->native, target);
+    }
+    // USER FUNCTIONS
+    else
+    {
+        CallSite call;
+        call.statement = &functionCall;
+        call.functionName = siFunctionCall->symbol;
+        call.argumentCount = functionCall.children().size();
+        chunk->calls.push_back(call);
+
+        unsigned int callIndex = chunk->calls.size() - 1;
+        emit_bx(OpCode::CALL_PREPARE, target, callIndex);
+
+        unsigned int firstArgument = registerTop;
+
+        for (auto& argument : functionCall.children())
+            compile_expression(argument, allocate_register());
+
+        emit(tail ? OpCode::TAIL_INVOKE : OpCode::INVOKE, target, firstArgument, functionCall.children().size());
+        registerTop = firstArgument;
+
+        chunk->calls[callIndex].skip = here();
+    }
+}
+
+/**
+ * Compiles a call to a native function. Errors in the call or its
+ * arguments are reported at the call, which then evaluates to nil.
+*/
+void Compiler::compile_native_call(const Statement& nativeCall, unsigned int native, unsigned int target)
+{
+    unsigned int enclosingSite = site;
+    unsigned int nativeSite = push_site(nativeCall, target);
+    unsigned int firstArgument = registerTop;
+
+    for (auto& argument : nativeCall.children())
+        compile_expression(argument, allocate_register());
+
+    emit(OpCode::CALL_NATIVE, target, firstArgument, native);
+    registerTop = firstArgument;
+
+    chunk->siteTable[nativeSite].resume = here();
+    site = enclosingSite;
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+Compiler::Compiler()
+{
+    chunk = nullptr;
+    registerTop = 0;
+    scopeDepth = 0;
+    site = NO_SITE;
+    loopChunk = false;
+}
+
+/**
+ * Compiles the root block and every function in it.
+*/
+Program* Compiler::compile(Statement* root)
+{
+    program.chunks.clear();
+    program.functions.clear();
+    program.chunks.emplace_back();
+
+    Chunk mainChunk;
+    mainChunk.name = "main";
+    chunk = &mainChunk;
+
+    compile_block(*root);
+    emit(OpCode::HALT);
+
+    program.chunks[0] = std::move(mainChunk);
+    chunk = nullptr;
+
+    return &program;
+}
+
+/**
+ * Compiles a chunk that calls a function of the compiled program on the
+ * arguments in the registers after the first, leaving its result in the
+ * first register. Lets code outside of the virtual machine call functions.
+*/
+unsigned int Compiler::compile_entry(Statement& function)
+{
+    SI_Function* siFunction = static_cast<SI_Function*>(function.info);
+
+    Chunk entryChunk;
+    entryChunk.name = "entry " + SymbolTable::global().get_name(siFunction->functionName);
+
+    chunk = &entryChunk;
+    registerTop = 0;
+    site = NO_SITE;
+
+    unsigned int callee = allocate_register();
+    emit_bx(OpCode::LOAD_CONST, callee, add_constant(Object::make_int32(program.functions.at(&function))));
+
+    for (unsigned int i = 0; i < siFunction->parameterNames.size(); ++i)
+        allocate_register();
+
+    emit(OpCode::INVOKE, callee, callee + 1, siFunction->parameterNames.size());
+    emit(OpCode::HALT);
+
+    program.chunks.push_back(std::move(entryChunk));
+    chunk = nullptr;
+
+    return program.chunks.size() - 1;
+}
+
+/**
+ * Compiles a loop into a chunk of its own, so a loop that is already
+ * running can go on in the virtual machine. The loop state lives in the
+ * stack, so it starts over at the condition. A loop of a function runs
+ * in the function's frame, a ret in it ends the chunk with the value.
+*/
+unsigned int Compiler::compile_loop(Statement& loop)
+{
+    Chunk newChunk;
+    newChunk.name = "loop";
+
+    chunk = &newChunk;
+    scopeDepth = 0;
+    site = NO_SITE;
+    loops.clear();
+    loopChunk = true;
+
+    compile_statement(loop);
+    emit(OpCode::HALT);
+
+    program.chunks.push_back(std::move(newChunk));
+    chunk = nullptr;
+    loopChunk = false;
+
+    return program.chunks.size() - 1;
+}
+
+/**
+ * Prints every chunk of the program.
+*/
+void Compiler::print_program()
+{
+    for (auto& chunk : program.chunks)
+    {
+        std::cout << "CHUNK " << chunk.name << " (" << chunk.registerCount << " registers)" << std::endl;
+
+        for (unsigned int i = 0; i < chunk.code.size(); ++i)
+        {
+            const Instruction& instruction = chunk.code[i];
+
+            std::cout << "\t" << i << "\t" << op_code_as_str(instruction.op) << "\t"
+                << instruction.a << " " << instruction.b << " " << instruction.c;
+
+            if (instruction.op == OpCode::GET_VAR)
+                std::cout << "\t; " << SymbolTable::global().get_name(chunk.names[instruction.bx()]);
+            else if (instruction.op == OpCode::DECLARE || instruction.op == OpCode::SET_VAR)
+                std::cout << "\t; " << SymbolTable::global().get_name(chunk.declarations[instruction.bx()].name)
+                    << " in slot " << chunk.declarations[instruction.bx()].slot;
+            else if (instruction.op == OpCode::CALL_NATIVE)
+                std::cout << "\t; " << SymbolTable::global().get_name(NativeTable::global().get_native(instruction.c).name);
+            else if (instruction.op == OpCode::CALL_PREPARE)
+                std::cout << "\t; " << SymbolTable::global().get_name(chunk.calls[instruction.bx()].functionName);
+            else if (instruction.op == OpCode::LOAD_CONST)
+                std::cout << "\t; " << Object(chunk.constants[instruction.bx()]).to_string().as_string();
+
+            std::cout << std::endl;
+        }
+    }
+}
+
+#pragma endregion
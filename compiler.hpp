@@ -0,0 +1,253 @@
+#ifndef COMPILER
+#define COMPILER
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "parser.hpp"
+#include "object.hpp"
+#include "natives.hpp"
+
+namespace pop
+{
+    /**
+     * The instructions understood by the virtual machine.
+     * R(x) is a register, K(x) a constant, N(x) a name,
+     * D(x) a declaration, the name of a variable and its frame slot,
+     * L(x) a loop with invariants and I(x) one of its invariants.
+    */
+    enum class OpCode : unsigned char
+    {
+        LOAD_CONST,     // R(a) = K(bx)
+        LOAD_NIL,       // R(a) = nil
+        GET_VAR,        // R(a) = scope[N(bx)], searched by name
+        GET_LOCAL,      // R(a) = frame slot bx
+        SET_LOCAL,      // frame slot bx = R(a)
+        DECLARE,        // declares D(bx) = R(a)
+        SET_VAR,        // sets D(bx) = R(a) by name, or declares it
+        ADD,            // R(a) = R(b) + R(c)
+        SUB,            // R(a) = R(b) - R(c)
+        MULT,           // R(a) = R(b) * R(c)
+        DIV,            // R(a) = R(b) / R(c)
+        MOD,            // R(a) = R(b) % R(c)
+        EQUALS,         // R(a) = R(b) == R(c)
+        NEQUALS,        // R(a) = R(b) != R(c)
+        GTHANE,         // R(a) = R(b) >= R(c)
+        LTHANE,         // R(a) = R(b) <= R(c)
+        GTHAN,          // R(a) = R(b) > R(c)
+        LTHAN,          // R(a) = R(b) < R(c)
+        NEGATE,         // R(a) = -R(b)
+        CALL_NATIVE,    // R(a) = native c(R(b) ... R(b + arity - 1))
+        CALL_PREPARE,   // R(a) = callee of call site bx, jumps past the call on failure
+        INVOKE,         // R(a) = R(a)(R(b) ... R(b + c - 1))
+        TAIL_INVOKE,    // returns R(a)(R(b) ... R(b + c - 1)), in place of the current function
+        RETURN,         // returns R(a)
+        RETURN_NIL,     // returns nil
+        JUMP,           // pc = bx
+        JUMP_IF_FALSE,  // if not R(a) then pc = bx
+        JUMP_IF_ERROR,  // if an error was reported then pc = bx
+        ENTER_SCOPE,    // starts running block bx
+        LEAVE_SCOPE,    // pops the last a blocks
+        ENTER_LOOP,     // gives loop L(bx) a new stamp
+        LEAVE_LOOP,     // gives the loop entered last its stamp back
+        LOAD_INVARIANT, // R(a) = invariant I(bx) and pc = its skip, if kept under the current stamp
+        STORE_INVARIANT, // keeps R(a) as invariant I(bx) under the current stamp
+        RAISE,          // reports the error message K(bx)
+        HALT
+    };
+
+    /**
+     * Converts op codes into strings.
+    */
+    static std::string op_code_as_str(const OpCode& op)
+    {
+        switch (op)
+        {
+        case OpCode::LOAD_CONST: return "LOAD_CONST";
+        case OpCode::LOAD_NIL: return "LOAD_NIL";
+        case OpCode::GET_VAR: return "GET_VAR";
+        case OpCode::GET_LOCAL: return "GET_LOCAL";
+        case OpCode::SET_LOCAL: return "SET_LOCAL";
+        case OpCode::DECLARE: return "DECLARE";
+        case OpCode::SET_VAR: return "SET_VAR";
+        case OpCode::ADD: return "ADD";
+        case OpCode::SUB: return "SUB";
+        case OpCode::MULT: return "MULT";
+        case OpCode::DIV: return "DIV";
+        case OpCode::MOD: return "MOD";
+        case OpCode::EQUALS: return "EQUALS";
+        case OpCode::NEQUALS: return "NEQUALS";
+        case OpCode::GTHANE: return "GTHANE";
+        case OpCode::LTHANE: return "LTHANE";
+        case OpCode::GTHAN: return "GTHAN";
+        case OpCode::LTHAN: return "LTHAN";
+        case OpCode::NEGATE: return "NEGATE";
+        case OpCode::CALL_NATIVE: return "CALL_NATIVE";
+        case OpCode::CALL_PREPARE: return "CALL_PREPARE";
+        case OpCode::INVOKE: return "INVOKE";
+        case OpCode::TAIL_INVOKE: return "TAIL_INVOKE";
+        case OpCode::RETURN: return "RETURN";
+        case OpCode::RETURN_NIL: return "RETURN_NIL";
+        case OpCode::JUMP: return "JUMP";
+        case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+        case OpCode::JUMP_IF_ERROR: return "JUMP_IF_ERROR";
+        case OpCode::ENTER_SCOPE: return "ENTER_SCOPE";
+        case OpCode::LEAVE_SCOPE: return "LEAVE_SCOPE";
+        case OpCode::ENTER_LOOP: return "ENTER_LOOP";
+        case OpCode::LEAVE_LOOP: return "LEAVE_LOOP";
+        case OpCode::LOAD_INVARIANT: return "LOAD_INVARIANT";
+        case OpCode::STORE_INVARIANT: return "STORE_INVARIANT";
+        case OpCode::RAISE: return "RAISE";
+        case OpCode::HALT: return "HALT";
+        }
+
+        return "NOT AN OP CODE";
+    }
+
+    /**
+     * A single 64 bit instruction.
+     * b and c can be read together as the 32 bit operand bx.
+    */
+    struct Instruction
+    {
+        OpCode op;
+        unsigned short a;
+        unsigned short b;
+        unsigned short c;
+
+        unsigned int bx() const { return b | (static_cast<unsigned int>(c) << 16); }
+    };
+
+    /**
+     * Where an error raised by an instruction is reported
+     * and where execution continues afterwards.
+    */
+    struct Site
+    {
+        const Statement* statement;
+        unsigned int resume;
+        int nilRegister;
+    };
+
+    /**
+     * A variable declared by an instruction. Slots and names can both
+     * go past what fits next to a register in a single instruction.
+    */
+    struct Declaration
+    {
+        unsigned int slot;
+        Symbol name;
+    };
+
+    /**
+     * A user function call site. The chunk of the function
+     * found last is cached together with the function epoch
+     * of the stack it was found in.
+    */
+    struct CallSite
+    {
+        const Statement* statement;
+        Symbol functionName;
+        unsigned int argumentCount;
+        unsigned int skip;
+        mutable int callee = -1;
+        mutable unsigned int calleeEpoch = 0;
+    };
+
+    /**
+     * A hoisted invariant and the instruction after its
+     * computation, where a kept value goes on.
+    */
+    struct InvariantSite
+    {
+        SI_Invariant* invariant;
+        unsigned int skip;
+    };
+
+    /**
+     * The compiled code of the top level block or of a function.
+     * A function chunk knows the function it was compiled from.
+    */
+    struct Chunk
+    {
+        std::string name;
+        std::vector<Instruction> code;
+        std::vector<unsigned int> sites;   // the site of each instruction
+        std::vector<Site> siteTable;
+        std::vector<Object> constants;
+        std::vector<Symbol> names;
+        std::vector<Declaration> declarations;
+        std::vector<Statement*> blocks;
+        std::vector<CallSite> calls;
+        std::vector<SI_Loop*> loops;
+        std::vector<InvariantSite> invariants;
+        std::vector<Symbol> parameterNames;
+        unsigned int registerCount = 0;
+        const Statement* function = nullptr;
+        bool memoized = false;
+    };
+
+    /**
+     * A compiled script. The first chunk is the top level block.
+    */
+    struct Program
+    {
+        std::vector<Chunk> chunks;
+        std::unordered_map<const Statement*, unsigned int> functions;
+    };
+
+    /**
+     * Compiles the statements of the parser into
+     * bytecode for the virtual machine.
+    */
+    class Compiler
+    {
+        /**
+         * The jumps that still need to be patched for a loop.
+        */
+        struct Loop
+        {
+            unsigned int start;
+            unsigned int scopeDepth;
+            std::vector<unsigned int> breaks;
+        };
+
+        Program program;
+        Chunk* chunk;
+        unsigned int registerTop;
+        unsigned int scopeDepth;
+        unsigned int site;
+        std::vector<Loop> loops;
+        bool loopChunk;
+
+        unsigned int emit(OpCode op, unsigned int a = 0, unsigned int b = 0, unsigned int c = 0);
+        unsigned int emit_bx(OpCode op, unsigned int a, unsigned int bx);
+        void patch(unsigned int instruction, unsigned int target);
+        unsigned int here() const;
+        unsigned int add_constant(const Object& constant);
+        unsigned int add_name(Symbol name);
+        unsigned int add_declaration(unsigned int slot, Symbol name);
+        unsigned int push_site(const Statement& statement, int nilRegister = -1);
+        unsigned int allocate_register();
+
+        void compile_function(Statement& function);
+        void compile_block(Statement& block);
+        void compile_statement(Statement& statement);
+        void compile_leave_scopes(unsigned int depth);
+        void compile_expression(const Statement& statement, unsigned int target);
+        void compile_operators(const Statement& chain, unsigned int target);
+        void compile_function_call(const Statement& functionCall, unsigned int target, bool tail = false);
+        void compile_native_call(const Statement& nativeCall, unsigned int native, unsigned int target);
+
+    public:
+        Compiler();
+
+        Program* compile(Statement* root);
+        unsigned int compile_entry(Statement& function);
+        unsigned int compile_loop(Statement& loop);
+        void print_program();
+    };
+}
+
+#endif
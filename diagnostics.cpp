@@ -8,7 +8,7 @@
 
 using namespace pop;
 
-void Diagnostics::add_warning(std::string message, std::string line, unsigned int lineColumn, unsigned int lineNumber)
+void Diagnostics::add_warning(std::string message, std::string_view line, unsigned int lineColumn, unsigned int lineNumber)
 {
     ++lineNumber;
 
@@ -18,11 +18,11 @@ void Diagnostics::add_warning(std::string message, std::string line, unsigned in
     for (int i = 0; i < lineColumn; ++i)
         space += ' ';
 
-    warning += message + "\n\t" + line + "\n\t" + space + "^" NC;
+    warning += message + "\n\t" + std::string(line) + "\n\t" + space + "^" NC;
     warnings.push_back(warning);
 }
 
-void Diagnostics::add_error(std::string message, std::string line, unsigned int lineColumn, unsigned int lineNumber)
+void Diagnostics::add_error(std::string message, std::string_view line, unsigned int lineColumn, unsigned int lineNumber)
 {
     ++lineNumber;
 
@@ -32,10 +32,35 @@ void Diagnostics::add_error(std::string message, std::string line, unsigned int
     for (int i = 0; i < lineColumn; ++i)
         space += ' ';
 
-    error += message + "\n\t" + line + "\n\t" + space + "^" NC;
+    error += message + "\n\t" + std::string(line) + "\n\t" + space + "^" NC;
     errors.push_back(error);
 }
 
+void Diagnostics::add_error(std::string message, unsigned int lineColumn, unsigned int lineNumber)
+{
+    std::string_view line;
+
+    if (file != nullptr && static_cast<int>(lineNumber) < file->get_length())
+        line = file->get_line(lineNumber);
+
+    add_error(message, line, lineColumn, lineNumber);
+}
+
+void Diagnostics::add_warning(std::string message, unsigned int lineColumn, unsigned int lineNumber)
+{
+    std::string_view line;
+
+    if (file != nullptr && static_cast<int>(lineNumber) < file->get_length())
+        line = file->get_line(lineNumber);
+
+    add_warning(message, line, lineColumn, lineNumber);
+}
+
+void Diagnostics::set_file(const File* file)
+{
+    this->file = file;
+}
+
 bool Diagnostics::has_warnings() const
 {
     return warnings.size() > 0;
@@ -48,9 +73,9 @@ bool Diagnostics::has_errors() const
 
 void Diagnostics::dump()
 {
-    for (auto& warning : warnings)
-        std::cout << warning << std::endl;
+    for (; dumpedWarnings < warnings.size(); ++dumpedWarnings)
+        std::cout << warnings[dumpedWarnings] << std::endl;
 
-    for (auto& error : errors)
-        std::cout << error << std::endl;
+    for (; dumpedErrors < errors.size(); ++dumpedErrors)
+        std::cout << errors[dumpedErrors] << std::endl;
 }
\ No newline at end of file
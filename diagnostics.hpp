@@ -3,8 +3,11 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <iostream>
 
+#include "file.hpp"
+
 namespace pop
 {
     /**
@@ -15,17 +18,35 @@ namespace pop
     {
         std::vector<std::string> warnings;
         std::vector<std::string> errors;
+        const File* file = nullptr;
+        unsigned int dumpedWarnings = 0;
+        unsigned int dumpedErrors = 0;
 
     public:
+        /**
+         * Sets the file errors given by line number are reported against.
+        */
+        void set_file(const File* file);
+
         /**
          * Adds a warning to the diagnostics.
         */
-        void add_warning(std::string message, std::string line, unsigned int lineColumn, unsigned int lineNumber);
+        void add_warning(std::string message, std::string_view line, unsigned int lineColumn, unsigned int lineNumber);
+
+        /**
+         * Adds a warning to the diagnostics, the line is looked up in the file.
+        */
+        void add_warning(std::string message, unsigned int lineColumn, unsigned int lineNumber);
 
         /**
          * Adds a error to the diagnostics.
         */
-        void add_error(std::string message, std::string line, unsigned int lineColumn, unsigned int lineNumber);
+        void add_error(std::string message, std::string_view line, unsigned int lineColumn, unsigned int lineNumber);
+
+        /**
+         * Adds a error to the diagnostics, the line is looked up in the file.
+        */
+        void add_error(std::string message, unsigned int lineColumn, unsigned int lineNumber);
 
         /**
          * Does the diagnostics have warnings.
@@ -37,6 +58,9 @@ namespace pop
         */
         bool has_errors() const;
 
+        /**
+         * Shows the diagnostics added since the last dump.
+        */
         void dump();
     };
 }
@@ -0,0 +1,767 @@
+#include "emitter.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <climits>
+
+using namespace pop;
+
+static const char* const BINARY_OP_NAMES[BINARY_OP_COUNT] = {
+    "ADD", "SUB", "MULT", "DIV", "MOD",
+    "EQUALS", "NEQUALS", "GTHANE", "LTHANE", "GTHAN", "LTHAN"
+};
+
+static const char* const BINARY_OP_SYMBOLS[BINARY_OP_COUNT] = {
+    "+", "-", "*", "/", "%",
+    "==", "!=", ">=", "<=", ">", "<"
+};
+
+static const std::string INDENT = "    ";
+
+// longer chains of operators are emitted one operator per C++ statement
+static const unsigned int NESTED_OPERATORS = 16;
+
+Emitter::Emitter()
+{
+    file = nullptr;
+    blockCount = 0;
+    constantCount = 0;
+    invariantCount = 0;
+    callCount = 0;
+    inFunction = false;
+}
+
+#pragma region Private Methods
+
+/**
+ * Turns text into a C++ string literal holding exactly the same bytes.
+*/
+std::string Emitter::quote(std::string_view text)
+{
+    std::string literal = "\"";
+
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            literal += '\\';
+            literal += c;
+        }
+        else if (c < ' ' || c > '~')
+        {
+            char escape[5];
+            snprintf(escape, sizeof(escape), "\\%03o", c);
+            literal += escape;
+        }
+        else
+        {
+            literal += c;
+        }
+    }
+
+    return literal + "\"";
+}
+
+/**
+ * Writes a float so it reads back as the same bits.
+*/
+std::string Emitter::float_literal(float value)
+{
+    if (!std::isfinite(value))
+    {
+        unsigned int bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return "Runtime::float_from_bits(" + std::to_string(bits) + "u)";
+    }
+
+    char literal[64];
+    snprintf(literal, sizeof(literal), "%af", CAST(value, double));
+    return std::signbit(value) ? "(" + std::string(literal) + ")" : std::string(literal);
+}
+
+std::string Emitter::as_object(const Code& code)
+{
+    switch (code.kind)
+    {
+    case Kind::INT32: return "Object::make_int32(" + code.text + ")";
+    case Kind::FLOAT32: return "Object::make_float32(" + code.text + ")";
+    case Kind::BOOL: return "Object::make_bool(" + code.text + ")";
+    default: return code.text;
+    }
+}
+
+std::string Emitter::as_int32(const Code& code)
+{
+    if (code.kind == Kind::INT32)
+        return code.text;
+
+    return as_object(code) + ".int32Value";
+}
+
+std::string Emitter::as_float32(const Code& code)
+{
+    if (code.kind == Kind::FLOAT32)
+        return code.text;
+
+    return as_object(code) + ".float32Value";
+}
+
+/**
+ * A condition is true when its object's bool is, whatever its type.
+*/
+std::string Emitter::as_condition(const Code& code)
+{
+    if (code.kind == Kind::BOOL)
+        return code.text;
+
+    return as_object(code) + ".boolValue";
+}
+
+/**
+ * The column and line errors of a statement are reported at.
+*/
+std::string Emitter::location(const Statement& statement)
+{
+    return std::to_string(statement.lineColumn) + ", " + std::to_string(statement.lineNumber);
+}
+
+unsigned int Emitter::add_symbol(Symbol symbol)
+{
+    auto found = symbols.find(symbol);
+
+    if (found != symbols.end())
+        return found->second;
+
+    unsigned int id = symbols.size();
+    symbols[symbol] = id;
+    declarations << "static const Symbol symbol_" << id << " = runtime.intern(" << quote(SymbolTable::global().get_name(symbol)) << ");\n";
+    return id;
+}
+
+unsigned int Emitter::add_native(unsigned int native)
+{
+    auto found = natives.find(native);
+
+    if (found != natives.end())
+        return found->second;
+
+    unsigned int id = natives.size();
+    natives[native] = id;
+    declarations << "static const unsigned int native_" << id << " = runtime.find_native("
+        << quote(SymbolTable::global().get_name(NativeTable::global().get_native(native).name)) << ");\n";
+    return id;
+}
+
+unsigned int Emitter::add_loop(const StatementInfo* info)
+{
+    auto found = loops.find(info);
+
+    if (found != loops.end())
+        return found->second;
+
+    unsigned int id = loops.size();
+    loops[info] = id;
+    declarations << "static unsigned int loop_" << id << "_stamp = 0;\n";
+    return id;
+}
+
+/**
+ * Gives every function a C++ function and declares it up front,
+ * so any block can make any function callable.
+*/
+void Emitter::collect_functions(const Statement& statement)
+{
+    if (statement.type == StatementType::FUNCTION)
+    {
+        SI_Function* siFunction = static_cast<SI_Function*>(statement.info);
+        unsigned int id = functions.size();
+        functions[&statement] = id;
+
+        declarations << "static Object function_" << id << "();\n";
+        declarations << "static Statement* function_info_" << id << " = runtime.add_function("
+            << quote(SymbolTable::global().get_name(siFunction->functionName)) << ", {";
+
+        for (unsigned int i = 0; i < siFunction->parameterNames.size(); ++i)
+            declarations << (i == 0 ? " " : ", ") << quote(SymbolTable::global().get_name(siFunction->parameterNames[i]));
+
+        declarations << (siFunction->parameterNames.empty() ? "}" : " }") << ", function_" << id << ");\n";
+    }
+
+    // expressions define no functions
+    if (statement.type == StatementType::EXP)
+        return;
+
+    for (auto& child : statement.children())
+        collect_functions(child);
+}
+
+/**
+ * Emits a function as a C++ function returning what it returns.
+*/
+void Emitter::emit_function(const Statement& function)
+{
+    bool enclosingInFunction = inFunction;
+    inFunction = true;
+
+    std::string body = emit_block(function.children()[0], INDENT);
+
+    definitions << "static Object function_" << functions[&function] << "()\n{\n"
+        << body << INDENT << "return Object();\n}\n\n";
+
+    inFunction = enclosingInFunction;
+}
+
+/**
+ * Emits the inside of a C++ scope running a block. Like the runner,
+ * the block is left after any statement once an error was reported.
+*/
+std::string Emitter::emit_block(const Statement& block, const std::string& indent)
+{
+    unsigned int id = blockCount++;
+    SI_Block* siBlock = static_cast<SI_Block*>(block.info);
+    std::string code;
+
+    if (siBlock->scoped)
+    {
+        declarations << "static Statement* block_" << id << " = runtime.add_block({";
+
+        for (unsigned int i = 0; i < siBlock->functions.size(); ++i)
+            declarations << (i == 0 ? " " : ", ") << "function_info_" << functions[siBlock->functions[i]];
+
+        declarations << (siBlock->functions.empty() ? "});\n" : " });\n");
+
+        code += indent + "BlockScope scope(runtime.stack, *block_" + std::to_string(id) + ");\n";
+    }
+
+    bool leaves = false;
+
+    unsigned int last = block.children().size();
+
+    while (last > 0 && block.children()[last - 1].type == StatementType::FUNCTION)
+        --last;
+
+    for (unsigned int i = 0; i < last; ++i)
+    {
+        const Statement& statement = block.children()[i];
+
+        if (statement.type == StatementType::FUNCTION)
+            continue;
+
+        code += emit_statement(statement, indent);
+
+        if (i + 1 < last && statement.type != StatementType::BREAK && statement.type != StatementType::CONTINUE && statement.type != StatementType::RETURN)
+        {
+            code += indent + "if (runtime.hasErrors)\n" + indent + INDENT + "goto block_" + std::to_string(id) + "_end;\n";
+            leaves = true;
+        }
+    }
+
+    if (leaves)
+        code += indent + "block_" + std::to_string(id) + "_end:;\n";
+
+    return code;
+}
+
+/**
+ * Emits a statement. Statements whose expressions can fail report
+ * the error at their own location and do nothing else.
+*/
+std::string Emitter::emit_statement(const Statement& statement, const std::string& indent)
+{
+    std::string inner = indent + INDENT;
+
+    // ASSIGNMENT STATEMENT
+    if (statement.type == StatementType::ASSIGN)
+    {
+        SI_Variable* siAssign = static_cast<SI_Variable*>(statement.info);
+        Code value = emit_expression(statement.children()[0]);
+        std::string store;
+
+        if (siAssign->byName)
+        {
+            std::string symbol = "symbol_" + std::to_string(add_symbol(siAssign->symbol));
+
+            store = "{ Object assigned = " + as_object(value) + "; if (!runtime.stack.set_variable(" + symbol
+                + ", assigned)) runtime.stack.declare_variable(" + std::to_string(siAssign->slot) + ", " + symbol + ", assigned); }\n";
+        }
+        else if (siAssign->declaration)
+        {
+            unsigned int symbol = add_symbol(siAssign->symbol);
+            store = "runtime.stack.declare_variable(" + std::to_string(siAssign->slot) + ", symbol_" + std::to_string(symbol) + ", " + as_object(value) + ");\n";
+        }
+        else
+        {
+            store = "runtime.stack.local(" + std::to_string(siAssign->slot) + ") = " + as_object(value) + ";\n";
+        }
+
+        if (!value.throws)
+            return indent + store;
+
+        return emit_guarded(inner + store, statement, indent);
+    }
+    // IF STATEMENT
+    else if (statement.type == StatementType::IF)
+    {
+        Code condition = emit_expression(statement.children()[0]);
+        std::string body = emit_block(statement.children()[1], condition.throws ? inner + INDENT : inner);
+        std::string branches = "if (" + as_condition(condition) + ")\n";
+        std::string branchIndent = condition.throws ? inner : indent;
+
+        branches = branchIndent + branches + branchIndent + "{\n" + body + branchIndent + "}\n";
+
+        if (statement.children().size() == 3)
+            branches += branchIndent + "else\n" + emit_statement(statement.children()[2], branchIndent);
+
+        if (!condition.throws)
+            return branches;
+
+        return emit_guarded(branches, statement, indent);
+    }
+    // ELSE STATEMENT
+    else if (statement.type == StatementType::ELSE)
+    {
+        return indent + "{\n" + emit_block(statement.children()[0], inner) + indent + "}\n";
+    }
+    // WHILE STATEMENT
+    else if (statement.type == StatementType::WHILE)
+    {
+        Code condition = emit_expression(statement.children()[0]);
+        std::string loopIndent = indent;
+        std::string code;
+
+        if (statement.info != nullptr)
+        {
+            loopIndent = inner;
+            code += indent + "{\n";
+            code += inner + "LoopStamp stamp(loop_" + std::to_string(add_loop(statement.info)) + "_stamp, runtime.lastLoopStamp);\n";
+        }
+
+        std::string bodyIndent = loopIndent + INDENT;
+
+        if (!condition.throws)
+        {
+            code += loopIndent + "while (" + as_condition(condition) + ")\n";
+            code += loopIndent + "{\n" + emit_block(statement.children()[1], bodyIndent) + loopIndent + "}\n";
+        }
+        else
+        {
+            code += loopIndent + "while (true)\n" + loopIndent + "{\n";
+            code += bodyIndent + "bool condition;\n\n";
+            code += bodyIndent + "try\n" + bodyIndent + "{\n";
+            code += bodyIndent + INDENT + "condition = " + as_condition(condition) + ";\n";
+            code += bodyIndent + "}\n" + bodyIndent + "catch (const ScriptError& error)\n" + bodyIndent + "{\n";
+            code += bodyIndent + INDENT + "runtime.report(error.what(), " + location(statement) + ");\n";
+            code += bodyIndent + INDENT + "break;\n" + bodyIndent + "}\n\n";
+            code += bodyIndent + "if (!condition)\n" + bodyIndent + INDENT + "break;\n\n";
+            code += bodyIndent + "{\n" + emit_block(statement.children()[1], bodyIndent + INDENT) + bodyIndent + "}\n";
+            code += loopIndent + "}\n";
+        }
+
+        if (statement.info != nullptr)
+            code += indent + "}\n";
+
+        return code;
+    }
+    // FUNCTION CALL STATEMENT
+    else if (statement.type == StatementType::FUNCTION_CALL)
+    {
+        Code call = emit_expression(statement);
+
+        if (!call.throws)
+            return indent + call.text + ";\n";
+
+        return emit_guarded(inner + call.text + ";\n", statement, indent);
+    }
+    // RETURN STATEMENT
+    else if (statement.type == StatementType::RETURN)
+    {
+        if (!inFunction)
+            return indent + "runtime.report(\"Cannot return here.\", " + location(statement) + ");\n";
+
+        const Statement* returned = &statement.children()[0];
+
+        while (returned->type == StatementType::EXP)
+            returned = &returned->children()[0];
+
+        // a tail call runs once the function has returned
+        bool tail = returned->type == StatementType::FUNCTION_CALL && static_cast<SI_FunctionCall*>(returned->info)->tail;
+        Code value = tail ? emit_function_call(*returned, true) : emit_expression(statement.children()[0]);
+
+        if (!value.throws)
+            return indent + "return " + as_object(value) + ";\n";
+
+        return emit_guarded(inner + "return " + as_object(value) + ";\n", statement, indent);
+    }
+    // BREAK STATEMENT
+    else if (statement.type == StatementType::BREAK)
+    {
+        return indent + "break;\n";
+    }
+    // CONTINUE STATEMENT
+    else if (statement.type == StatementType::CONTINUE)
+    {
+        return indent + "continue;\n";
+    }
+
+    return indent + "runtime.report(\"Bad statement!\", " + location(statement) + ");\n";
+}
+
+/**
+ * Wraps code that can fail so the error is reported at the statement.
+*/
+std::string Emitter::emit_guarded(const std::string& body, const Statement& statement, const std::string& indent)
+{
+    return indent + "try\n" + indent + "{\n" + body + indent + "}\n"
+        + indent + "catch (const ScriptError& error)\n" + indent + "{\n"
+        + indent + INDENT + "runtime.report(error.what(), " + location(statement) + ");\n"
+        + indent + "}\n";
+}
+
+Emitter::Code Emitter::emit_expression(const Statement& expression)
+{
+    if (is_binary_operator(expression.type))
+        return emit_operators(expression);
+
+    switch (expression.type)
+    {
+    case StatementType::CONSTANT:
+        return emit_constant(static_cast<SI_Constant*>(expression.info)->value);
+    case StatementType::NUMBER:
+        return { "Runtime::parse_number(" + quote(static_cast<SI_String*>(expression.info)->value) + ")", Kind::BOXED, true, false };
+    case StatementType::STRING:
+        return { "Object::make_string(" + quote(static_cast<SI_String*>(expression.info)->value) + ")", Kind::BOXED, false, false };
+    case StatementType::CHAR:
+        return emit_constant(Object::make_char(static_cast<SI_String*>(expression.info)->value[0]));
+    case StatementType::BOOLEAN:
+        return { static_cast<SI_Boolean*>(expression.info)->value ? "true" : "false", Kind::BOOL, false, false };
+    case StatementType::VARIABLE:
+        {
+            SI_Variable* siVariable = static_cast<SI_Variable*>(expression.info);
+
+            if (siVariable->slot >= 0)
+                return { "runtime.stack.local(" + std::to_string(siVariable->slot) + ")", Kind::BOXED, false, false };
+
+            return { "runtime.stack.get_variable(symbol_" + std::to_string(add_symbol(siVariable->symbol)) + ")", Kind::BOXED, false, false };
+        }
+    case StatementType::EXP:
+        return emit_expression(expression.children()[0]);
+    case StatementType::INVARIANT:
+        return emit_invariant(expression);
+    case StatementType::INLINE:
+        {
+            Code value = emit_expression(expression.children()[0]);
+
+            if (!value.throws)
+                return value;
+
+            // an inlined function reports its errors where it returns
+            return { "[&]() -> Object { try { return " + as_object(value) + "; } catch (const ScriptError& error) { runtime.report(error.what(), "
+                + location(expression) + "); return Object(); } }()", Kind::BOXED, false, value.calls };
+        }
+    case StatementType::NEGATE_OP:
+        {
+            Code value = emit_expression(expression.children()[0]);
+
+            // bools are promoted to int like the runner does
+            if (value.kind == Kind::INT32 || value.kind == Kind::BOOL)
+                return { "(-1 * " + value.text + ")", Kind::INT32, value.throws, value.calls };
+
+            if (value.kind == Kind::FLOAT32)
+                return { "(-1 * " + value.text + ")", Kind::FLOAT32, value.throws, value.calls };
+
+            return { "Runtime::negate(" + value.text + ")", Kind::BOXED, true, value.calls };
+        }
+    case StatementType::FUNCTION_CALL:
+        {
+            SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(expression.info);
+
+            if (siFunctionCall->native >= 0)
+                return emit_native_call(expression, siFunctionCall->native);
+
+            return emit_function_call(expression);
+        }
+    default:
+        return { "Object()", Kind::BOXED, false, false };
+    }
+}
+
+/**
+ * Emits a constant. Numbers and bools stay plain C++ values,
+ * strings are built once when the program starts.
+*/
+Emitter::Code Emitter::emit_constant(const Object& value)
+{
+    switch (value.type)
+    {
+    case ObjectType::INT32:
+        if (value.int32Value == INT_MIN)
+            return { "(-2147483647 - 1)", Kind::INT32, false, false };
+        if (value.int32Value < 0)
+            return { "(" + std::to_string(value.int32Value) + ")", Kind::INT32, false, false };
+        return { std::to_string(value.int32Value), Kind::INT32, false, false };
+    case ObjectType::FLOAT32:
+        return { float_literal(value.float32Value), Kind::FLOAT32, false, false };
+    case ObjectType::BOOL:
+        return { value.boolValue ? "true" : "false", Kind::BOOL, false, false };
+    case ObjectType::CHAR:
+        return { "Object::make_char(" + std::to_string(CAST(value.charValue, int)) + ")", Kind::BOXED, false, false };
+    case ObjectType::STRING:
+        {
+            unsigned int id = constantCount++;
+            declarations << "static const Object constant_" << id << " = Object::make_string(" << quote(value.as_string()) << ");\n";
+            return { "constant_" + std::to_string(id), Kind::BOXED, false, false };
+        }
+    default:
+        return { "Object()", Kind::BOXED, false, false };
+    }
+}
+
+/**
+ * Emits a chain of operators from its first operand up. A short chain
+ * nests like the tree does. A longer one becomes a lambda keeping each
+ * operator's value in a variable of its own, so neither the emitter nor
+ * the C++ compiler nests as deep as the chain is long.
+*/
+Emitter::Code Emitter::emit_operators(const Statement& chain)
+{
+    std::vector<const Statement*> operators;
+    Code left = emit_expression(collect_operator_chain(chain, operators));
+
+    if (operators.size() <= NESTED_OPERATORS)
+    {
+        for (auto op = operators.rbegin(); op != operators.rend(); ++op)
+            left = emit_operator(**op, left, emit_expression((*op)->children()[1]));
+
+        return left;
+    }
+
+    std::string text = "[&]() { auto operand_0 = " + left.text + "; ";
+    Code value = { "operand_0", left.kind, false, false };
+    bool throws = left.throws;
+    bool calls = left.calls;
+
+    for (unsigned int i = 0; i < operators.size(); ++i)
+    {
+        const Statement& op = *operators[operators.size() - 1 - i];
+        Code step = emit_operator(op, value, emit_expression(op.children()[1]));
+        std::string name = "operand_" + std::to_string(i + 1);
+
+        text += "auto " + name + " = " + step.text + "; ";
+        value = { name, step.kind, false, false };
+        throws = throws || step.throws;
+        calls = calls || step.calls;
+    }
+
+    return { text + "return " + value.text + "; }()", value.kind, throws, calls };
+}
+
+/**
+ * Emits a binary operator on the code of its operands. Typed operators
+ * become plain C++ operators on ints, floats or strings, every other one
+ * goes through the kernel table of Object. Operands are evaluated left
+ * to right, so typed operands that could both call something go through
+ * the table too.
+*/
+Emitter::Code Emitter::emit_operator(const Statement& statement, const Code& left, const Code& right)
+{
+    BinaryOp op = binary_op_of(statement.type);
+    const char* symbol = BINARY_OP_SYMBOLS[CAST(op, int)];
+
+    bool throws = left.throws || right.throws;
+    bool calls = left.calls || right.calls;
+    bool comparison = op >= BinaryOp::EQUALS;
+    bool ordered = !(left.calls && right.calls);
+    std::string operation = std::string(" ") + symbol + " ";
+
+    if (ordered && statement.specialization == Specialization::TYPED_INT32)
+        return { "(" + as_int32(left) + operation + as_int32(right) + ")", comparison ? Kind::BOOL : Kind::INT32, throws, calls };
+
+    if (ordered && statement.specialization == Specialization::TYPED_FLOAT32 && op != BinaryOp::MOD)
+        return { "(" + as_float32(left) + operation + as_float32(right) + ")", comparison ? Kind::BOOL : Kind::FLOAT32, throws, calls };
+
+    if (ordered && statement.specialization == Specialization::TYPED_STRING && (comparison || op == BinaryOp::ADD))
+    {
+        std::string strings = "(" + as_object(left) + ".as_string()" + operation + as_object(right) + ".as_string())";
+
+        if (comparison)
+            return { strings, Kind::BOOL, throws, calls };
+
+        return { "Object::make_string" + strings, Kind::BOXED, throws, calls };
+    }
+
+    return { "Runtime::apply(BinaryOp::" + std::string(BINARY_OP_NAMES[CAST(op, int)]) + ", Operands { " + as_object(left) + ", " + as_object(right) + " })", Kind::BOXED, true, calls };
+}
+
+/**
+ * Emits an invariant, kept in a static the first time it is
+ * evaluated under the current stamp of its loop.
+*/
+Emitter::Code Emitter::emit_invariant(const Statement& invariant)
+{
+    SI_Invariant* siInvariant = static_cast<SI_Invariant*>(invariant.info);
+    Code value = emit_expression(invariant.children()[0]);
+
+    std::string id = std::to_string(invariantCount++);
+    std::string stamp = "loop_" + std::to_string(add_loop(siInvariant->loop)) + "_stamp";
+    std::string type = "Object";
+
+    if (value.kind == Kind::INT32)
+        type = "int";
+    else if (value.kind == Kind::FLOAT32)
+        type = "float";
+    else if (value.kind == Kind::BOOL)
+        type = "bool";
+
+    declarations << "static " << type << " invariant_" << id << ";\n";
+    declarations << "static unsigned int invariant_" << id << "_stamp = 0;\n";
+
+    std::string text = "[&]() -> " + type + " { if (invariant_" + id + "_stamp == " + stamp + ") return invariant_" + id + "; "
+        + "invariant_" + id + " = " + value.text + "; invariant_" + id + "_stamp = " + stamp + "; return invariant_" + id + "; }()";
+
+    return { text, value.kind, value.throws, value.calls };
+}
+
+/**
+ * Emits a call to a native. Errors in its arguments and
+ * in the native itself are reported at the call.
+*/
+Emitter::Code Emitter::emit_native_call(const Statement& nativeCall, unsigned int native)
+{
+    std::string id = std::to_string(add_native(native));
+    std::vector<Code> arguments;
+    bool argumentsThrow = false;
+    bool calls = !NativeTable::global().get_native(native).pure;
+
+    for (auto& argument : nativeCall.children())
+    {
+        arguments.push_back(emit_expression(argument));
+        argumentsThrow = argumentsThrow || arguments.back().throws;
+        calls = calls || arguments.back().calls;
+    }
+
+    if (arguments.empty())
+        return { "runtime.call_native(native_" + id + ", nullptr, " + location(nativeCall) + ")", Kind::BOXED, false, calls };
+
+    std::string call = "runtime.call_native(native_" + id + ", arguments, " + location(nativeCall) + ")";
+
+    std::string text = "[&]() -> Object { ";
+
+    if (!argumentsThrow)
+    {
+        text += "Object arguments[] = { ";
+
+        for (unsigned int i = 0; i < arguments.size(); ++i)
+            text += (i == 0 ? "" : ", ") + as_object(arguments[i]);
+
+        text += " }; ";
+    }
+    else
+    {
+        text += "Object arguments[" + std::to_string(arguments.size()) + "]; try { ";
+
+        for (unsigned int i = 0; i < arguments.size(); ++i)
+            text += "arguments[" + std::to_string(i) + "] = " + as_object(arguments[i]) + "; ";
+
+        text += "} catch (const ScriptError& error) { runtime.report(error.what(), " + location(nativeCall) + "); return Object(); } ";
+    }
+
+    return { text + "return " + call + "; }()", Kind::BOXED, false, calls };
+}
+
+/**
+ * Emits a call to a user function. The function is found before
+ * its arguments are evaluated, which become its first slots.
+ * A tail call only keeps its arguments for the runtime to make
+ * the call once the returning function is done.
+*/
+Emitter::Code Emitter::emit_function_call(const Statement& functionCall, bool tail)
+{
+    SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(functionCall.info);
+    unsigned int symbol = add_symbol(siFunctionCall->symbol);
+    std::string id = std::to_string(callCount++);
+
+    declarations << "static EmittedCall call_" << id << " = { symbol_" << symbol << ", "
+        << functionCall.children().size() << ", " << location(functionCall) << " };\n";
+
+    std::string pushes;
+    std::string arguments;
+    bool argumentsThrow = false;
+
+    for (auto& argument : functionCall.children())
+    {
+        Code code = emit_expression(argument);
+        argumentsThrow = argumentsThrow || code.throws;
+        pushes += "runtime.stack.push_argument(" + as_object(code) + "); ";
+        arguments += (arguments.empty() ? "" : ", ") + as_object(code);
+    }
+
+    std::string find = "[&]() -> Object { SI_Emitted* function = runtime.find_function(call_" + id + "); "
+        "if (function == nullptr) return Object(); ";
+
+    if (tail)
+        return { find + "return runtime.tail_call(*function, { " + arguments + " }); }()", Kind::BOXED, argumentsThrow, true };
+
+    // a failing argument unwinds the ones pushed before it
+    if (argumentsThrow)
+        pushes = "try { " + pushes + "} catch (const ScriptError&) { runtime.stack.unwind(frameBase); throw; } ";
+
+    std::string text = find + "unsigned int frameBase = runtime.stack.get_top(); "
+        + pushes + "return runtime.invoke(*function, frameBase, call_" + id + "); }()";
+
+    return { text, Kind::BOXED, argumentsThrow, true };
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+/**
+ * Emits a whole script as a C++ program.
+*/
+std::string Emitter::emit(const Statement* root, const File* file)
+{
+    this->file = file;
+    declarations.str("");
+    definitions.str("");
+    functions.clear();
+    loops.clear();
+    symbols.clear();
+    natives.clear();
+    blockCount = 0;
+    constantCount = 0;
+    invariantCount = 0;
+    callCount = 0;
+    inFunction = false;
+
+    collect_functions(*root);
+
+    // functions are emitted in the order they were collected
+    std::vector<const Statement*> ordered(functions.size());
+
+    for (auto& function : functions)
+        ordered[function.second] = function.first;
+
+    for (auto& function : ordered)
+        emit_function(*function);
+
+    std::string script = emit_block(*root, INDENT);
+
+    std::ostringstream program;
+    program << "// emitted by pop --emit-cpp\n";
+    program << "#include \"runtime.hpp\"\n\n";
+    program << "using namespace pop;\n\n";
+    program << "static Runtime runtime;\n\n";
+    program << declarations.str() << "\n";
+    program << definitions.str();
+    program << "static void run_script()\n{\n" << script << "}\n\n";
+    program << "int main()\n{\n";
+
+    for (int i = 0; i < file->get_length(); ++i)
+        program << INDENT << "runtime.add_line(" << quote(file->get_line(i)) << ");\n";
+
+    program << "\n" << INDENT << "return runtime.run(run_script);\n}\n";
+    return program.str();
+}
+
+#pragma endregion
@@ -0,0 +1,93 @@
+#ifndef EMITTER
+#define EMITTER
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <unordered_map>
+
+#include "file.hpp"
+#include "parser.hpp"
+#include "object.hpp"
+#include "natives.hpp"
+
+namespace pop
+{
+    /**
+     * Lowers the statements of the parser into a C++ program that runs
+     * on the Runtime. Variables, functions and errors go through the same
+     * stack and diagnostics as the runner, so the program prints exactly
+     * what the runner would. Operators the type checker typed become
+     * plain int and float arithmetic.
+    */
+    class Emitter
+    {
+        /**
+         * How the C++ code of an expression holds its value,
+         * boxed in an Object or as a plain C++ value.
+        */
+        enum class Kind : char
+        {
+            BOXED,
+            INT32,
+            FLOAT32,
+            BOOL
+        };
+
+        /**
+         * The C++ code of an expression.
+        */
+        struct Code
+        {
+            std::string text;
+            Kind kind;
+            bool throws;    // can throw a ScriptError
+            bool calls;     // can run code with side effects
+        };
+
+        const File* file;
+        std::ostringstream declarations;
+        std::ostringstream definitions;
+        std::unordered_map<const Statement*, unsigned int> functions;
+        std::unordered_map<const StatementInfo*, unsigned int> loops;
+        std::unordered_map<Symbol, unsigned int> symbols;
+        std::unordered_map<unsigned int, unsigned int> natives;
+        unsigned int blockCount;
+        unsigned int constantCount;
+        unsigned int invariantCount;
+        unsigned int callCount;
+        bool inFunction;
+
+        static std::string quote(std::string_view text);
+        static std::string float_literal(float value);
+        static std::string as_object(const Code& code);
+        static std::string as_int32(const Code& code);
+        static std::string as_float32(const Code& code);
+        static std::string as_condition(const Code& code);
+        static std::string location(const Statement& statement);
+
+        unsigned int add_symbol(Symbol symbol);
+        unsigned int add_native(unsigned int native);
+        unsigned int add_loop(const StatementInfo* info);
+
+        void collect_functions(const Statement& statement);
+        void emit_function(const Statement& function);
+        std::string emit_block(const Statement& block, const std::string& indent);
+        std::string emit_statement(const Statement& statement, const std::string& indent);
+        std::string emit_guarded(const std::string& body, const Statement& statement, const std::string& indent);
+        Code emit_expression(const Statement& expression);
+        Code emit_constant(const Object& value);
+        Code emit_operators(const Statement& chain);
+        Code emit_operator(const Statement& statement, const Code& left, const Code& right);
+        Code emit_invariant(const Statement& invariant);
+        Code emit_native_call(const Statement& nativeCall, unsigned int native);
+        Code emit_function_call(const Statement& functionCall, bool tail = false);
+
+    public:
+        Emitter();
+
+        std::string emit(const Statement* root, const File* file);
+    };
+}
+
+#endif
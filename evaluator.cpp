@@ -0,0 +1,309 @@
+#include "evaluator.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using namespace pop;
+
+#pragma region Helpers
+
+/**
+ * If an integer division would trap instead of giving a value.
+ * The script is left to hit that itself.
+*/
+static bool traps(BinaryOp op, const Object& left, const Object& right)
+{
+    if (op != BinaryOp::DIV && op != BinaryOp::MOD)
+        return false;
+
+    if ((right.type == ObjectType::INT32 && right.int32Value == 0) ||
+        (right.type == ObjectType::CHAR && right.charValue == 0) ||
+        (right.type == ObjectType::BOOL && !right.boolValue))
+        return true;
+
+    return left.type == ObjectType::INT32 && left.int32Value == std::numeric_limits<int>::min() &&
+        right.type == ObjectType::INT32 && right.int32Value == -1;
+}
+
+#pragma endregion
+
+#pragma region Private Methods
+
+/**
+ * Takes steps from the budget of the call, giving up once it is spent.
+*/
+void Evaluator::spend(std::size_t count)
+{
+    if (count > steps)
+        throw Unknown();
+
+    steps -= count;
+}
+
+/**
+ * Runs a function in a frame of its own, the arguments being its first slots.
+*/
+Object Evaluator::run_function(unsigned int index, std::vector<Object>& arguments)
+{
+    const Statement& function = ast->get(index);
+    SI_Function* siFunction = static_cast<SI_Function*>(function.info);
+
+    if (!siFunction->pure || siFunction->parameterNames.size() != arguments.size())
+        throw Unknown();
+
+    // a call the script could not make without going too deep is left to fail there
+    if (depth + 1 >= depthLimit || depth >= MAX_DEPTH)
+        throw Unknown();
+
+    std::vector<Object>* callerFrame = frame;
+    frame = &arguments;
+    ++depth;
+
+    Object result;
+    run_block(function.children()[0], result);
+
+    frame = callerFrame;
+    --depth;
+
+    return result;
+}
+
+Evaluator::Flow Evaluator::run_block(const Statement& block, Object& result)
+{
+    for (auto& statement : block.children())
+    {
+        Flow flow = run_statement(statement, result);
+
+        if (flow != Flow::NEXT)
+            return flow;
+    }
+
+    return Flow::NEXT;
+}
+
+/**
+ * Runs a statement the way the runner does.
+*/
+Evaluator::Flow Evaluator::run_statement(const Statement& statement, Object& result)
+{
+    spend(1);
+
+    switch (statement.type)
+    {
+    case StatementType::FUNCTION:
+        return Flow::NEXT;
+    case StatementType::ASSIGN:
+        {
+            SI_Variable* siAssign = static_cast<SI_Variable*>(statement.info);
+            int slot = siAssign->slot;
+
+            if (slot < 0 || siAssign->byName)
+                throw Unknown();
+
+            Object value = eval_expression(statement.children()[0]);
+
+            if (frame->size() <= CAST(slot, unsigned int))
+                frame->resize(slot + 1);
+
+            (*frame)[slot] = value;
+        }
+        return Flow::NEXT;
+    case StatementType::IF:
+        if (eval_expression(statement.children()[0]).boolValue)
+            return run_block(statement.children()[1], result);
+
+        if (statement.children().size() == 3)
+            return run_statement(statement.children()[2], result);
+
+        return Flow::NEXT;
+    case StatementType::ELSE:
+        return run_block(statement.children()[0], result);
+    case StatementType::WHILE:
+        while (eval_expression(statement.children()[0]).boolValue)
+        {
+            Flow flow = run_block(statement.children()[1], result);
+
+            if (flow == Flow::BREAK)
+                break;
+
+            if (flow == Flow::RETURN)
+                return flow;
+        }
+        return Flow::NEXT;
+    case StatementType::FUNCTION_CALL:
+        eval_expression(statement);
+        return Flow::NEXT;
+    case StatementType::RETURN:
+        result = eval_expression(statement.children()[0]);
+        return Flow::RETURN;
+    case StatementType::BREAK:
+        return Flow::BREAK;
+    case StatementType::CONTINUE:
+        return Flow::CONTINUE;
+    default:
+        throw Unknown();
+    }
+}
+
+/**
+ * Evaluates an expression. Literals are constants by now, what
+ * is left of them failed to build and fails in the script too.
+*/
+Object Evaluator::eval_expression(const Statement& expression)
+{
+    if (is_binary_operator(expression.type))
+        return eval_operators(expression);
+
+    spend(1);
+
+    switch (expression.type)
+    {
+    case StatementType::CONSTANT:
+        return static_cast<SI_Constant*>(expression.info)->value;
+    case StatementType::EXP:
+        return eval_expression(expression.children()[0]);
+    case StatementType::VARIABLE:
+        {
+            int slot = static_cast<SI_Variable*>(expression.info)->slot;
+
+            if (slot < 0 || CAST(slot, unsigned int) >= frame->size())
+                throw Unknown();
+
+            return (*frame)[slot];
+        }
+    case StatementType::FUNCTION_CALL:
+        return eval_call(expression);
+    case StatementType::NEGATE_OP:
+        {
+            Object value = eval_expression(expression.children()[0]);
+
+            if (!value.try_negate())
+                throw Unknown();
+
+            return value;
+        }
+    default:
+        throw Unknown();
+    }
+}
+
+/**
+ * Calls a pure native or a function the evaluator knows. The resolver
+ * made sure a pure function only calls functions that are the only
+ * ones with their name, so the call finds the same one the script does.
+*/
+Object Evaluator::eval_call(const Statement& functionCall)
+{
+    SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(functionCall.info);
+    std::vector<Object> arguments;
+
+    for (auto& argument : functionCall.children())
+        arguments.push_back(eval_expression(argument));
+
+    if (siFunctionCall->native < 0)
+    {
+        auto function = functions.find(siFunctionCall->symbol);
+
+        if (function == functions.end())
+            throw Unknown();
+
+        return run_function(function->second, arguments);
+    }
+
+    const Native& native = NativeTable::global().get_native(siFunctionCall->native);
+
+    if (!native.pure)
+        throw Unknown();
+
+    Object result;
+
+    try
+    {
+        result = native.function(arguments.data());
+    }
+    catch (const std::exception& exp)
+    {
+        throw Unknown();
+    }
+
+    if (result.type == ObjectType::STRING)
+        spend(result.as_string().size());
+
+    return result;
+}
+
+/**
+ * Evaluates a chain of operators from its first operand up.
+*/
+Object Evaluator::eval_operators(const Statement& chain)
+{
+    std::vector<const Statement*> operators;
+    Object left = eval_expression(collect_operator_chain(chain, operators));
+
+    for (auto op = operators.rbegin(); op != operators.rend(); ++op)
+    {
+        spend(1);
+
+        BinaryOp binaryOp = binary_op_of((*op)->type);
+        Object right = eval_expression((*op)->children()[1]);
+
+        if (traps(binaryOp, left, right) || !left.try_apply(binaryOp, right))
+            throw Unknown();
+
+        if (left.type == ObjectType::STRING)
+            spend(left.as_string().size());
+    }
+
+    return left;
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+/**
+ * Forgets every function and refills the budget of the load.
+*/
+void Evaluator::reset(Ast* ast)
+{
+    this->ast = ast;
+    functions.clear();
+    loadSteps = LOAD_STEPS;
+}
+
+/**
+ * Lets calls find a function, by its index in the Ast.
+*/
+void Evaluator::add_function(Symbol name, unsigned int function)
+{
+    functions[name] = function;
+}
+
+/**
+ * Runs a pure function with the given arguments.
+ * Returns false if the evaluator gave up.
+*/
+bool Evaluator::evaluate(unsigned int function, std::vector<Object>& arguments, Object& result)
+{
+    unsigned int budget = std::min(CALL_STEPS, loadSteps);
+    steps = budget;
+    depth = 0;
+    frame = nullptr;
+
+    bool done;
+
+    try
+    {
+        result = run_function(function, arguments);
+        done = true;
+    }
+    catch (const Unknown& unknown)
+    {
+        done = false;
+    }
+
+    loadSteps -= budget - steps;
+    return done;
+}
+
+#pragma endregion
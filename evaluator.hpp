@@ -0,0 +1,69 @@
+#ifndef EVALUATOR
+#define EVALUATOR
+
+#include <vector>
+#include <unordered_map>
+
+#include "parser.hpp"
+#include "object.hpp"
+#include "natives.hpp"
+#include "runner.hpp"
+
+namespace pop
+{
+    /**
+     * Runs pure functions while the script loads, so a call whose
+     * arguments are all constants can become the constant it returns.
+     * Only a call that returns without any error is worked out, as
+     * soon as the evaluator is not sure what the script would do it
+     * gives up and the call runs as usual.
+     *
+     * Every statement, every expression and every character of a
+     * string that is built costs a step. A call gets CALL_STEPS of
+     * them and all calls of a load LOAD_STEPS together, so functions
+     * that take long or never return cost only that much loading.
+    */
+    class Evaluator
+    {
+        enum class Flow
+        {
+            NEXT,
+            RETURN,
+            BREAK,
+            CONTINUE,
+        };
+
+        // thrown when the evaluator gives up
+        struct Unknown {};
+
+        Ast* ast;
+        std::unordered_map<Symbol, unsigned int> functions;
+        std::vector<Object>* frame;
+        unsigned int steps;
+        unsigned int loadSteps;
+        unsigned int depth;
+        unsigned int depthLimit = RecursionLimit::DEFAULT;
+
+        void spend(std::size_t count);
+
+        Object run_function(unsigned int index, std::vector<Object>& arguments);
+        Flow run_block(const Statement& block, Object& result);
+        Flow run_statement(const Statement& statement, Object& result);
+        Object eval_expression(const Statement& expression);
+        Object eval_call(const Statement& functionCall);
+        Object eval_operators(const Statement& chain);
+
+    public:
+        static const unsigned int CALL_STEPS = 1 << 16;
+        static const unsigned int LOAD_STEPS = 1 << 20;
+        // calls nest on the C++ stack
+        static const unsigned int MAX_DEPTH = 64;
+
+        void set_depth_limit(unsigned int limit) { depthLimit = limit; }
+        void reset(Ast* ast);
+        void add_function(Symbol name, unsigned int function);
+        bool evaluate(unsigned int function, std::vector<Object>& arguments, Object& result);
+    };
+}
+
+#endif
@@ -1,34 +1,188 @@
 #include "file.hpp"
 
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 using namespace pop;
 
-File::File(std::string fileName) 
+#pragma region Private Methods
+
+/**
+ * Maps the file into memory. Returns false if it could
+ * not be mapped so the file can be read instead.
+*/
+bool File::map_file(const std::string& fileName)
 {
-    std::ifstream ifs(fileName);
+#ifdef _WIN32
+    return false;
+#else
+    int descriptor = open(fileName.c_str(), O_RDONLY);
+
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+
+    // empty files can not be mapped
+    if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0)
+    {
+        close(descriptor);
+        return false;
+    }
+
+    if (status.st_size >= 0xFFFFFFFF)
+    {
+        close(descriptor);
+        throw std::runtime_error("File is too large!");
+    }
+
+    void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+
+    if (address == MAP_FAILED)
+        return false;
+
+    // the source is read front to back exactly once
+    madvise(address, status.st_size, MADV_SEQUENTIAL);
+
+    source = static_cast<const char*>(address);
+    sourceSize = status.st_size;
+    mapped = true;
+    return true;
+#endif
+}
+
+/**
+ * Reads the whole file into the buffer. Files that can be seeked
+ * are read with a single allocation, pipes and other streams are
+ * read in chunks until they end.
+*/
+void File::read_file(const std::string& fileName)
+{
+    std::ifstream ifs(fileName, std::ios::binary);
 
     if (!ifs.is_open())
         throw std::runtime_error("Could not open file!");
 
-    for (std::string line; std::getline(ifs, line); )
-        add_line(line);
+    ifs.seekg(0, std::ios::end);
+    std::streamoff size = ifs.tellg();
+
+    if (size >= 0xFFFFFFFF)
+        throw std::runtime_error("File is too large!");
+
+    if (size > 0)
+    {
+        buffer.resize(size);
+        ifs.seekg(0);
+        ifs.read(&buffer[0], buffer.size());
+        buffer.resize(ifs.gcount());
+    }
+    else
+    {
+        // the size of a pipe is not known up front
+        ifs.clear();
+
+        char chunk[65536];
+
+        while (ifs.read(chunk, sizeof(chunk)) || ifs.gcount() > 0)
+        {
+            if (buffer.size() + ifs.gcount() >= 0xFFFFFFFF)
+                throw std::runtime_error("File is too large!");
+
+            buffer.append(chunk, ifs.gcount());
+        }
+    }
 
     ifs.close();
+
+    source = buffer.data();
+    sourceSize = buffer.size();
+}
+
+/**
+ * Records where every line starts. The table ends with the offset
+ * one past the last line's newline, real or not, so line i always
+ * ends one character before line i + 1 starts.
+*/
+void File::index_lines()
+{
+    lineStarts.clear();
+
+    unsigned int start = 0;
+
+    while (start < sourceSize)
+    {
+        lineStarts.push_back(start);
+
+        const void* newline = memchr(source + start, '\n', sourceSize - start);
+
+        if (newline == nullptr)
+            start = sourceSize + 1;
+        else
+            start = static_cast<const char*>(newline) - source + 1;
+    }
+
+    lineStarts.push_back(start);
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+File::File()
+{
+    source = nullptr;
+    sourceSize = 0;
+    mapped = false;
+    lineStarts.push_back(0);
+}
+
+File::File(std::string fileName) 
+{
+    source = nullptr;
+    sourceSize = 0;
+    mapped = false;
+
+    if (!map_file(fileName))
+        read_file(fileName);
+
+    index_lines();
+}
+
+File::~File()
+{
+#ifndef _WIN32
+    if (mapped)
+        munmap(const_cast<char*>(source), sourceSize);
+#endif
 }
 
 /**
  * Retrieves a line from the file.
 */
-std::string File::get_line(const int& index)
+std::string_view File::get_line(const int& index) const
 {
-    return lines[index];
+    unsigned int sourceLines = lineStarts.size() - 1;
+
+    if (index >= sourceLines)
+        return addedLines[index - sourceLines];
+
+    return std::string_view(source + lineStarts[index], lineStarts[index + 1] - lineStarts[index] - 1);
 }
 
 /**
- * Adds a line to the file.
+ * Adds a line to the file. Added lines are stored
+ * on their own so views handed out earlier stay valid.
 */
 void File::add_line(std::string line)
 {
-    lines.push_back(line);
+    addedLines.push_back(line);
 }
 
 /**
@@ -36,5 +190,7 @@ void File::add_line(std::string line)
 */
 int File::get_length() const
 {
-    return lines.size();
-}
\ No newline at end of file
+    return lineStarts.size() - 1 + addedLines.size();
+}
+
+#pragma endregion
@@ -2,7 +2,9 @@
 #define _FILE
 
 #include <vector>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <stdexcept>
 
@@ -10,20 +12,41 @@ namespace pop
 {
     /**
      * This structure is used for saving the contents
-     * of a file as lines in memory.
+     * of a file in memory. The file is memory mapped when
+     * the platform allows it and read into one buffer when
+     * it does not. Lines are found through a table of the
+     * offsets they start at and handed out as views, so
+     * tokens and statements can point into the source
+     * without copying it.
     */
     struct File
     {
     private:
-        std::vector<std::string> lines;
+        const char* source;
+        unsigned int sourceSize;
+        bool mapped;
+        std::string buffer;
+        std::vector<unsigned int> lineStarts;
+        std::deque<std::string> addedLines;
+
+        bool map_file(const std::string& fileName);
+        void read_file(const std::string& fileName);
+        void index_lines();
 
     public:
+        /**
+         * Creates an empty in-memory file, fill it with add_line.
+        */
+        File();
         File(std::string fileName);
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+        ~File();
 
         /**
          * Gets a line from the file.
         */
-        std::string get_line(const int& index);
+        std::string_view get_line(const int& index) const;
 
         /**
          * Adds a line to the file.
@@ -34,12 +57,7 @@ namespace pop
          * Gets the file length in lines.
         */
         int get_length() const;
-
-        /**
-         * Loads a file.
-        */
-        void load_file(std::string name);
     };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,780 @@
+#include "jit.hpp"
+#include "vm.hpp"
+
+#include <cstring>
+#include <cstdint>
+
+#ifdef JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+using namespace pop;
+
+#ifdef JIT_SUPPORTED
+
+#pragma region Assembler
+
+namespace
+{
+    enum Register : unsigned char
+    {
+        RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+        R12 = 12, R13 = 13, R14 = 14
+    };
+
+    enum Condition : unsigned char
+    {
+        CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7, CC_P = 0xA, CC_NP = 0xB,
+        CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+    };
+
+    // the compiled code keeps the context, registers and frame slots here
+    const Register CONTEXT = RBX;
+    const Register REGS = R12;
+    const Register LOCALS = R13;
+
+    const int TYPE_OFFSET = offsetof(Object, type);
+    const int VALUE_OFFSET = offsetof(Object, int32Value);
+    const int OBJECT_SIZE = sizeof(Object);
+    const int SLOT_OFFSET = offsetof(StackAllocation, value);
+    const int SLOT_SIZE = sizeof(StackAllocation);
+
+    // the templates copy objects as two 8 byte words and read every scalar at VALUE_OFFSET
+    static_assert(sizeof(Object) == 16, "the JIT copies objects as two 8 byte words");
+    static_assert(offsetof(Object, boolValue) == offsetof(Object, int32Value)
+        && offsetof(Object, float32Value) == offsetof(Object, int32Value),
+        "the JIT reads bools, ints and floats at the same offset");
+
+    /**
+     * A jump whose target is only known once every instruction is placed.
+     * Targets below the instruction count are instructions, the rest are
+     * the exits of instructions, counted from the instruction count.
+    */
+    struct Fixup
+    {
+        unsigned int position;
+        unsigned int target;
+    };
+
+    /**
+     * Encodes the few x86-64 instructions the templates are made of.
+     * Memory operands are always a base register and a 32 bit offset.
+    */
+    struct Assembler
+    {
+        std::vector<unsigned char> bytes;
+        std::vector<Fixup> fixups;
+
+        void byte(unsigned int value) { bytes.push_back(CAST(value, unsigned char)); }
+
+        void dword(uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+                byte(value >> (i * 8));
+        }
+
+        void qword(uint64_t value)
+        {
+            for (int i = 0; i < 8; ++i)
+                byte(value >> (i * 8));
+        }
+
+        void rex(bool wide, unsigned int reg, unsigned int base)
+        {
+            unsigned int prefix = 0x40 | (wide << 3) | (((reg >> 3) & 1) << 2) | ((base >> 3) & 1);
+
+            if (prefix != 0x40)
+                byte(prefix);
+        }
+
+        void memory(unsigned int reg, unsigned int base, int offset)
+        {
+            byte(0x80 | ((reg & 7) << 3) | (base & 7));
+
+            // r12 and rsp as a base need a scale index byte
+            if ((base & 7) == RSP)
+                byte(0x24);
+
+            dword(offset);
+        }
+
+        // op reg, [base + offset] or op [base + offset], reg
+        void op(bool wide, std::initializer_list<unsigned int> opcode, unsigned int reg, unsigned int base, int offset)
+        {
+            rex(wide, reg, base);
+
+            for (auto value : opcode)
+                byte(value);
+
+            memory(reg, base, offset);
+        }
+
+        // op xmm, [base + offset] with a mandatory prefix
+        void sse(unsigned int prefix, unsigned int opcode, unsigned int xmm, unsigned int base, int offset)
+        {
+            if (prefix != 0)
+                byte(prefix);
+
+            rex(false, xmm, base);
+            byte(0x0F);
+            byte(opcode);
+            memory(xmm, base, offset);
+        }
+
+        void cmp_byte(unsigned int base, int offset, unsigned int value)
+        {
+            op(false, { 0x80 }, 7, base, offset);
+            byte(value);
+        }
+
+        void store_byte(unsigned int base, int offset, unsigned int value)
+        {
+            op(false, { 0xC6 }, 0, base, offset);
+            byte(value);
+        }
+
+        void mov_imm64(unsigned int reg, uint64_t value)
+        {
+            rex(true, 0, reg);
+            byte(0xB8 | (reg & 7));
+            qword(value);
+        }
+
+        void setcc(Condition condition, unsigned int reg)
+        {
+            byte(0x0F);
+            byte(0x90 | condition);
+            byte(0xC0 | reg);
+        }
+
+        void jcc(Condition condition, unsigned int target)
+        {
+            byte(0x0F);
+            byte(0x80 | condition);
+            fixups.push_back({ CAST(bytes.size(), unsigned int), target });
+            dword(0);
+        }
+
+        void jmp(unsigned int target)
+        {
+            byte(0xE9);
+            fixups.push_back({ CAST(bytes.size(), unsigned int), target });
+            dword(0);
+        }
+
+        void jmp_to(unsigned int position)
+        {
+            byte(0xE9);
+            dword(position - (bytes.size() + 4));
+        }
+    };
+
+    int reg_offset(unsigned int reg) { return reg * OBJECT_SIZE; }
+    int local_offset(unsigned int slot) { return slot * SLOT_SIZE + SLOT_OFFSET; }
+}
+
+#pragma endregion
+
+#pragma region Templates
+
+namespace
+{
+    /**
+     * Emits the templates of one chunk.
+    */
+    struct TemplateCompiler
+    {
+        Assembler assembler;
+        const Chunk& chunk;
+        unsigned int count;
+        std::vector<bool> needsExit;
+
+        TemplateCompiler(const Chunk& chunk) : chunk(chunk), count(chunk.code.size()), needsExit(chunk.code.size(), false) { }
+
+        unsigned int exit_of(unsigned int index)
+        {
+            needsExit[index] = true;
+            return count + index;
+        }
+
+        /**
+         * Leaves to the interpreter at an instruction it has to run.
+        */
+        void leave(unsigned int index, unsigned int epilogue)
+        {
+            assembler.mov_imm64(RAX, reinterpret_cast<uint64_t>(chunk.code.data() + index));
+            assembler.jmp_to(epilogue);
+        }
+
+        /**
+         * Guards that an object is not a string, so it can be
+         * overwritten without dropping a reference.
+        */
+        void guard_writable(unsigned int base, int offset, unsigned int index)
+        {
+            assembler.cmp_byte(base, offset + TYPE_OFFSET, CAST(ObjectType::STRING, unsigned int));
+            assembler.jcc(CC_E, exit_of(index));
+        }
+
+        void guard_type(unsigned int base, int offset, ObjectType type, unsigned int exit)
+        {
+            assembler.cmp_byte(base, offset + TYPE_OFFSET, CAST(type, unsigned int));
+            assembler.jcc(CC_NE, exit);
+        }
+
+        /**
+         * Stores rax as the value of an object of the given type.
+        */
+        void store_value(unsigned int base, int offset, ObjectType type)
+        {
+            assembler.op(true, { 0x89 }, RAX, base, offset + VALUE_OFFSET);
+            assembler.store_byte(base, offset + TYPE_OFFSET, CAST(type, unsigned int));
+        }
+
+        /**
+         * Copies an object that is not a string.
+        */
+        void copy_object(unsigned int fromBase, int fromOffset, unsigned int toBase, int toOffset, unsigned int index)
+        {
+            assembler.cmp_byte(fromBase, fromOffset + TYPE_OFFSET, CAST(ObjectType::STRING, unsigned int));
+            assembler.jcc(CC_E, exit_of(index));
+            guard_writable(toBase, toOffset, index);
+
+            assembler.op(true, { 0x8B }, RAX, fromBase, fromOffset);
+            assembler.op(true, { 0x89 }, RAX, toBase, toOffset);
+            assembler.op(true, { 0x8B }, RAX, fromBase, fromOffset + 8);
+            assembler.op(true, { 0x89 }, RAX, toBase, toOffset + 8);
+        }
+
+        /**
+         * Calls a helper with the context and the instruction, leaving
+         * to the interpreter at whatever instruction it returns.
+        */
+        void call_helper(const void* helper, unsigned int index, unsigned int epilogue)
+        {
+            // mov rdi, rbx
+            assembler.bytes.insert(assembler.bytes.end(), { 0x48, 0x89, 0xDF });
+            assembler.mov_imm64(RSI, reinterpret_cast<uint64_t>(chunk.code.data() + index));
+            assembler.mov_imm64(RAX, reinterpret_cast<uint64_t>(helper));
+            // call rax, test rax, rax
+            assembler.bytes.insert(assembler.bytes.end(), { 0xFF, 0xD0, 0x48, 0x85, 0xC0 });
+            assembler.byte(0x0F);
+            assembler.byte(0x80 | CC_NE);
+            assembler.dword(epilogue - (assembler.bytes.size() + 4));
+        }
+
+        /**
+         * Calls a helper with the context and the instruction,
+         * jumping to the target when it returns anything.
+        */
+        void call_helper_branch(const void* helper, unsigned int index, unsigned int target)
+        {
+            // mov rdi, rbx
+            assembler.bytes.insert(assembler.bytes.end(), { 0x48, 0x89, 0xDF });
+            assembler.mov_imm64(RSI, reinterpret_cast<uint64_t>(chunk.code.data() + index));
+            assembler.mov_imm64(RAX, reinterpret_cast<uint64_t>(helper));
+            // call rax, test rax, rax
+            assembler.bytes.insert(assembler.bytes.end(), { 0xFF, 0xD0, 0x48, 0x85, 0xC0 });
+            assembler.jcc(CC_NE, target);
+        }
+
+        void compile_binary(const Instruction& instruction, unsigned int index)
+        {
+            // the compiler never puts the right operand in the result register
+            int left = reg_offset(instruction.b);
+            int right = reg_offset(instruction.c);
+            int result = reg_offset(instruction.a);
+            unsigned int exit = exit_of(index);
+            Assembler& as = assembler;
+
+            std::vector<unsigned int> doneJumps;
+
+            // int32 operands
+            guard_type(REGS, left, ObjectType::INT32, count * 2 + index);
+            guard_type(REGS, right, ObjectType::INT32, exit);
+            guard_writable(REGS, result, index);
+
+            as.op(false, { 0x8B }, RAX, REGS, left + VALUE_OFFSET);
+
+            switch (instruction.op)
+            {
+            case OpCode::ADD: as.op(false, { 0x03 }, RAX, REGS, right + VALUE_OFFSET); store_value(REGS, result, ObjectType::INT32); break;
+            case OpCode::SUB: as.op(false, { 0x2B }, RAX, REGS, right + VALUE_OFFSET); store_value(REGS, result, ObjectType::INT32); break;
+            case OpCode::MULT: as.op(false, { 0x0F, 0xAF }, RAX, REGS, right + VALUE_OFFSET); store_value(REGS, result, ObjectType::INT32); break;
+            case OpCode::DIV:
+            case OpCode::MOD:
+                // dividing by zero or -1 is left to the interpreter
+                as.op(false, { 0x8B }, RCX, REGS, right + VALUE_OFFSET);
+                as.bytes.insert(as.bytes.end(), { 0x83, 0xF9, 0x00 });
+                as.jcc(CC_E, exit);
+                as.bytes.insert(as.bytes.end(), { 0x83, 0xF9, 0xFF });
+                as.jcc(CC_E, exit);
+                // cdq, idiv ecx
+                as.bytes.insert(as.bytes.end(), { 0x99, 0xF7, 0xF9 });
+
+                // the remainder is in edx
+                if (instruction.op == OpCode::MOD)
+                    as.bytes.insert(as.bytes.end(), { 0x89, 0xD0 });
+
+                store_value(REGS, result, ObjectType::INT32);
+                break;
+            default:
+                {
+                    Condition condition = CC_E;
+
+                    switch (instruction.op)
+                    {
+                    case OpCode::EQUALS: condition = CC_E; break;
+                    case OpCode::NEQUALS: condition = CC_NE; break;
+                    case OpCode::GTHANE: condition = CC_GE; break;
+                    case OpCode::LTHANE: condition = CC_LE; break;
+                    case OpCode::GTHAN: condition = CC_G; break;
+                    default: condition = CC_L; break;
+                    }
+
+                    as.op(false, { 0x3B }, RAX, REGS, right + VALUE_OFFSET);
+                    as.setcc(condition, RAX);
+                    // movzx eax, al
+                    as.bytes.insert(as.bytes.end(), { 0x0F, 0xB6, 0xC0 });
+                    store_value(REGS, result, ObjectType::BOOL);
+                }
+                break;
+            }
+
+            doneJumps.push_back(as.bytes.size());
+            as.byte(0xE9);
+            as.dword(0);
+
+            // float32 operands, jumped to when the left operand is not an int32
+            floatStarts.push_back({ index, CAST(as.bytes.size(), unsigned int) });
+
+            if (instruction.op == OpCode::MOD)
+            {
+                as.jmp(exit);
+            }
+            else
+            {
+                guard_type(REGS, left, ObjectType::FLOAT32, exit);
+                guard_type(REGS, right, ObjectType::FLOAT32, exit);
+                guard_writable(REGS, result, index);
+
+                switch (instruction.op)
+                {
+                case OpCode::ADD: compile_float_arithmetic(0x58, left, right, result); break;
+                case OpCode::SUB: compile_float_arithmetic(0x5C, left, right, result); break;
+                case OpCode::MULT: compile_float_arithmetic(0x59, left, right, result); break;
+                case OpCode::DIV: compile_float_arithmetic(0x5E, left, right, result); break;
+                case OpCode::EQUALS:
+                    compile_float_compare(left, right);
+                    // sete al, setnp cl, and al, cl
+                    as.setcc(CC_E, RAX);
+                    as.setcc(CC_NP, RCX);
+                    as.bytes.insert(as.bytes.end(), { 0x20, 0xC8 });
+                    break;
+                case OpCode::NEQUALS:
+                    compile_float_compare(left, right);
+                    // setne al, setp cl, or al, cl
+                    as.setcc(CC_NE, RAX);
+                    as.setcc(CC_P, RCX);
+                    as.bytes.insert(as.bytes.end(), { 0x08, 0xC8 });
+                    break;
+                case OpCode::GTHANE: compile_float_compare(left, right); as.setcc(CC_AE, RAX); break;
+                case OpCode::GTHAN: compile_float_compare(left, right); as.setcc(CC_A, RAX); break;
+                // unordered compares are false, so less than is greater than swapped
+                case OpCode::LTHANE: compile_float_compare(right, left); as.setcc(CC_AE, RAX); break;
+                default: compile_float_compare(right, left); as.setcc(CC_A, RAX); break;
+                }
+
+                if (instruction.op >= OpCode::EQUALS)
+                {
+                    as.bytes.insert(as.bytes.end(), { 0x0F, 0xB6, 0xC0 });
+                    store_value(REGS, result, ObjectType::BOOL);
+                }
+            }
+
+            unsigned int done = as.bytes.size();
+
+            for (auto jump : doneJumps)
+            {
+                uint32_t relative = done - (jump + 5);
+                std::memcpy(&as.bytes[jump + 1], &relative, 4);
+            }
+        }
+
+        void compile_float_arithmetic(unsigned int opcode, int left, int right, int result)
+        {
+            assembler.sse(0xF3, 0x10, 0, REGS, left + VALUE_OFFSET);
+            assembler.sse(0xF3, opcode, 0, REGS, right + VALUE_OFFSET);
+            // movd eax, xmm0
+            assembler.bytes.insert(assembler.bytes.end(), { 0x66, 0x0F, 0x7E, 0xC0 });
+            store_value(REGS, result, ObjectType::FLOAT32);
+        }
+
+        void compile_float_compare(int left, int right)
+        {
+            assembler.sse(0xF3, 0x10, 0, REGS, left + VALUE_OFFSET);
+            assembler.sse(0, 0x2E, 0, REGS, right + VALUE_OFFSET);
+        }
+
+        std::vector<std::pair<unsigned int, unsigned int>> floatStarts;
+    };
+}
+
+#pragma endregion
+
+#endif
+
+#pragma region Private Methods
+
+/**
+ * Compiles every instruction of a chunk. Returns code without
+ * memory if the chunk can not be compiled.
+*/
+JitCode Jit::compile(const Chunk& chunk)
+{
+    JitCode code;
+
+#ifdef JIT_SUPPORTED
+    TemplateCompiler compiler(chunk);
+    Assembler& as = compiler.assembler;
+    unsigned int count = compiler.count;
+
+    // push rbx, r12, r13, r14 and keep the stack aligned for calls
+    as.bytes.insert(as.bytes.end(), { 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x48, 0x83, 0xEC, 0x08 });
+    // mov rbx, rdi
+    as.bytes.insert(as.bytes.end(), { 0x48, 0x89, 0xFB });
+    as.op(true, { 0x8B }, REGS, CONTEXT, offsetof(JitContext, regs));
+    as.op(true, { 0x8B }, LOCALS, CONTEXT, offsetof(JitContext, locals));
+    // jmp rsi
+    as.bytes.insert(as.bytes.end(), { 0xFF, 0xE6 });
+
+    // the shared way out, the instruction to go on with is in rax
+    unsigned int epilogue = as.bytes.size();
+    as.bytes.insert(as.bytes.end(), { 0x48, 0x83, 0xC4, 0x08, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3 });
+
+    code.offsets.resize(count);
+
+    for (unsigned int index = 0; index < count; ++index)
+    {
+        const Instruction& instruction = chunk.code[index];
+        code.offsets[index] = as.bytes.size();
+
+        switch (instruction.op)
+        {
+        case OpCode::LOAD_CONST:
+            {
+                const Object& constant = chunk.constants[instruction.bx()];
+
+                if (constant.type == ObjectType::STRING)
+                {
+                    compiler.call_helper(reinterpret_cast<const void*>(&Jit::load_const), index, epilogue);
+                    break;
+                }
+
+                uint64_t words[2];
+                std::memcpy(words, &constant, sizeof(words));
+
+                compiler.guard_writable(REGS, reg_offset(instruction.a), index);
+                as.mov_imm64(RAX, words[0]);
+                as.op(true, { 0x89 }, RAX, REGS, reg_offset(instruction.a));
+                as.mov_imm64(RAX, words[1]);
+                as.op(true, { 0x89 }, RAX, REGS, reg_offset(instruction.a) + 8);
+            }
+            break;
+        case OpCode::LOAD_NIL:
+            compiler.guard_writable(REGS, reg_offset(instruction.a), index);
+            // xor eax, eax
+            as.bytes.insert(as.bytes.end(), { 0x31, 0xC0 });
+            compiler.store_value(REGS, reg_offset(instruction.a), ObjectType::NIL);
+            break;
+        case OpCode::GET_VAR:
+            compiler.call_helper(reinterpret_cast<const void*>(&Jit::get_var), index, epilogue);
+            break;
+        case OpCode::GET_LOCAL:
+            compiler.copy_object(LOCALS, local_offset(instruction.bx()), REGS, reg_offset(instruction.a), index);
+            break;
+        case OpCode::SET_LOCAL:
+            compiler.copy_object(REGS, reg_offset(instruction.a), LOCALS, local_offset(instruction.bx()), index);
+            break;
+        case OpCode::ADD:
+        case OpCode::SUB:
+        case OpCode::MULT:
+        case OpCode::DIV:
+        case OpCode::MOD:
+        case OpCode::EQUALS:
+        case OpCode::NEQUALS:
+        case OpCode::GTHANE:
+        case OpCode::LTHANE:
+        case OpCode::GTHAN:
+        case OpCode::LTHAN:
+            compiler.compile_binary(instruction, index);
+            break;
+        case OpCode::NEGATE:
+            compiler.guard_type(REGS, reg_offset(instruction.b), ObjectType::INT32, compiler.exit_of(index));
+            compiler.guard_writable(REGS, reg_offset(instruction.a), index);
+            as.op(false, { 0x8B }, RAX, REGS, reg_offset(instruction.b) + VALUE_OFFSET);
+            // neg eax
+            as.bytes.insert(as.bytes.end(), { 0xF7, 0xD8 });
+            compiler.store_value(REGS, reg_offset(instruction.a), ObjectType::INT32);
+            break;
+        case OpCode::CALL_NATIVE:
+            compiler.call_helper(reinterpret_cast<const void*>(&Jit::call_native), index, epilogue);
+            break;
+        case OpCode::JUMP:
+            as.jmp(instruction.bx());
+            break;
+        case OpCode::JUMP_IF_FALSE:
+            as.cmp_byte(REGS, reg_offset(instruction.a) + VALUE_OFFSET, 0);
+            as.jcc(CC_E, instruction.bx());
+            break;
+        case OpCode::JUMP_IF_ERROR:
+            as.op(true, { 0x8B }, RAX, CONTEXT, offsetof(JitContext, hasErrors));
+            as.cmp_byte(RAX, 0, 0);
+            as.jcc(CC_NE, instruction.bx());
+            break;
+        case OpCode::ENTER_SCOPE:
+            compiler.call_helper(reinterpret_cast<const void*>(&Jit::enter_scope), index, epilogue);
+            break;
+        case OpCode::LEAVE_SCOPE:
+            compiler.call_helper(reinterpret_cast<const void*>(&Jit::leave_scope), index, epilogue);
+            break;
+        case OpCode::ENTER_LOOP:
+            compiler.call_helper(reinterpret_cast<const void*>(&Jit::enter_loop), index, epilogue);
+            break;
+        case OpCode::LEAVE_LOOP:
+            compiler.call_helper(reinterpret_cast<const void*>(&Jit::leave_loop), index, epilogue);
+            break;
+        case OpCode::LOAD_INVARIANT:
+            compiler.call_helper_branch(reinterpret_cast<const void*>(&Jit::load_invariant), index, chunk.invariants[instruction.bx()].skip);
+            break;
+        case OpCode::STORE_INVARIANT:
+            compiler.call_helper(reinterpret_cast<const void*>(&Jit::store_invariant), index, epilogue);
+            break;
+        default:
+            // calls, returns and declarations change the frame
+            compiler.leave(index, epilogue);
+            break;
+        }
+    }
+
+    // the exits of guards, the interpreter runs the instruction instead
+    std::vector<unsigned int> exits(count, 0);
+
+    for (unsigned int index = 0; index < count; ++index)
+    {
+        if (!compiler.needsExit[index])
+            continue;
+
+        exits[index] = as.bytes.size();
+        as.store_byte(CONTEXT, offsetof(JitContext, bailedOut), 1);
+        compiler.leave(index, epilogue);
+    }
+
+    std::vector<unsigned int> floats(count, 0);
+
+    for (auto& start : compiler.floatStarts)
+        floats[start.first] = start.second;
+
+    for (auto& fixup : as.fixups)
+    {
+        unsigned int target;
+
+        if (fixup.target < count)
+            target = code.offsets[fixup.target];
+        else if (fixup.target < count * 2)
+            target = exits[fixup.target - count];
+        else
+            target = floats[fixup.target - count * 2];
+
+        uint32_t relative = target - (fixup.position + 4);
+        std::memcpy(&as.bytes[fixup.position], &relative, 4);
+    }
+
+    void* memory = mmap(nullptr, as.bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED)
+        return JitCode();
+
+    std::memcpy(memory, as.bytes.data(), as.bytes.size());
+
+    if (mprotect(memory, as.bytes.size(), PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, as.bytes.size());
+        return JitCode();
+    }
+
+    code.memory = static_cast<unsigned char*>(memory);
+    code.size = as.bytes.size();
+#endif
+
+    return code;
+}
+
+void Jit::release(JitCode& code)
+{
+#ifdef JIT_SUPPORTED
+    if (code.memory != nullptr)
+        munmap(code.memory, code.size);
+#endif
+
+    code = JitCode();
+}
+
+#pragma endregion
+
+#pragma region Helpers
+
+/**
+ * Calls a native for compiled code. Exceptions can not pass through
+ * the machine code, so a failed call returns to the interpreter at
+ * the call with the error to raise there.
+*/
+const Instruction* Jit::call_native(JitContext* context, const Instruction* instruction)
+{
+    Object* regs = context->regs;
+
+    try
+    {
+        regs[instruction->a] = NativeTable::global().get_native(instruction->c).function(regs + instruction->b);
+    }
+    catch (const std::exception& exp)
+    {
+        *context->error = exp.what();
+        return instruction;
+    }
+
+    return nullptr;
+}
+
+const Instruction* Jit::get_var(JitContext* context, const Instruction* instruction)
+{
+    context->regs[instruction->a] = context->vm->stack.get_variable(context->chunk->names[instruction->bx()]);
+    return nullptr;
+}
+
+const Instruction* Jit::load_const(JitContext* context, const Instruction* instruction)
+{
+    context->regs[instruction->a] = context->chunk->constants[instruction->bx()];
+    return nullptr;
+}
+
+const Instruction* Jit::enter_scope(JitContext* context, const Instruction* instruction)
+{
+    context->vm->stack.enter_block(*context->chunk->blocks[instruction->bx()]);
+    return nullptr;
+}
+
+const Instruction* Jit::leave_scope(JitContext* context, const Instruction* instruction)
+{
+    for (unsigned int i = 0; i < instruction->a; ++i)
+        context->vm->stack.exit_block();
+
+    return nullptr;
+}
+
+const Instruction* Jit::enter_loop(JitContext* context, const Instruction* instruction)
+{
+    context->vm->enter_loop(context->chunk->loops[instruction->bx()]);
+    return nullptr;
+}
+
+const Instruction* Jit::leave_loop(JitContext* context, const Instruction*)
+{
+    context->vm->leave_loop();
+    return nullptr;
+}
+
+/**
+ * Returns the instruction when the invariant was kept,
+ * which makes the compiled code skip its computation.
+*/
+const Instruction* Jit::load_invariant(JitContext* context, const Instruction* instruction)
+{
+    if (context->vm->load_invariant(context->chunk->invariants[instruction->bx()], context->regs[instruction->a]))
+        return instruction;
+
+    return nullptr;
+}
+
+const Instruction* Jit::store_invariant(JitContext* context, const Instruction* instruction)
+{
+    context->vm->store_invariant(context->chunk->invariants[instruction->bx()], context->regs[instruction->a]);
+    return nullptr;
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+Jit::~Jit()
+{
+    for (auto& code : codes)
+        release(code);
+}
+
+/**
+ * Forgets every compiled chunk, for a program with this many chunks.
+*/
+void Jit::reset(unsigned int chunkCount)
+{
+    for (auto& code : codes)
+        release(code);
+
+    codes.assign(chunkCount, JitCode());
+    counters.assign(chunkCount, 0);
+    bailouts.assign(chunkCount, 0);
+    given.assign(chunkCount, false);
+}
+
+/**
+ * Makes room for chunks added to the program since, keeping the compiled ones.
+*/
+void Jit::grow(unsigned int chunkCount)
+{
+    if (chunkCount <= codes.size())
+        return;
+
+    codes.resize(chunkCount);
+    counters.resize(chunkCount, 0);
+    bailouts.resize(chunkCount, 0);
+    given.resize(chunkCount, false);
+}
+
+/**
+ * Counts a loop or call of a chunk and gets where its compiled code
+ * for an instruction starts, or nullptr if it is not compiled (yet).
+*/
+const void* Jit::entry(const Chunk& chunk, unsigned int chunkIndex, unsigned int instruction)
+{
+    if (codes[chunkIndex].memory != nullptr)
+        return codes[chunkIndex].memory + codes[chunkIndex].offsets[instruction];
+
+    if (given[chunkIndex] || ++counters[chunkIndex] < HOT_THRESHOLD)
+        return nullptr;
+
+    given[chunkIndex] = true;
+    codes[chunkIndex] = compile(chunk);
+
+    if (codes[chunkIndex].memory == nullptr)
+        return nullptr;
+
+    return codes[chunkIndex].memory + codes[chunkIndex].offsets[instruction];
+}
+
+/**
+ * Runs compiled code and returns the instruction the interpreter goes on with.
+*/
+const Instruction* Jit::run(unsigned int chunkIndex, JitContext& context, const void* entry)
+{
+    context.bailedOut = false;
+
+    JitFunction function = reinterpret_cast<JitFunction>(codes[chunkIndex].memory);
+    const Instruction* next = function(&context, entry);
+
+    if (context.bailedOut && ++bailouts[chunkIndex] >= BAILOUT_LIMIT)
+        release(codes[chunkIndex]);
+
+    return next;
+}
+
+#pragma endregion
@@ -0,0 +1,103 @@
+#ifndef JIT
+#define JIT
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include "compiler.hpp"
+#include "runner.hpp"
+
+// the jit writes x86-64 machine code into mapped pages
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED
+#endif
+
+namespace pop
+{
+    class VirtualMachine;
+
+    /**
+     * What compiled code reads while it runs. The registers and the
+     * frame slots do not move while compiled code runs, nothing it
+     * does can grow them.
+    */
+    struct JitContext
+    {
+        Object* regs;
+        StackAllocation* locals;
+        const bool* hasErrors;
+        VirtualMachine* vm;
+        const Chunk* chunk;
+        std::string* error;     // set when a native failed, the instruction returned raises it
+        bool bailedOut;
+    };
+
+    /**
+     * Runs compiled code from an entry point until it reaches an
+     * instruction it leaves to the interpreter, which it returns.
+    */
+    typedef const Instruction* (*JitFunction)(JitContext* context, const void* entry);
+
+    /**
+     * A chunk compiled to machine code, with where the code of
+     * every instruction starts.
+    */
+    struct JitCode
+    {
+        unsigned char* memory = nullptr;
+        std::size_t size = 0;
+        std::vector<unsigned int> offsets;
+    };
+
+    /**
+     * A baseline template compiler from bytecode to x86-64.
+     *
+     * Every instruction of a chunk that gets hot is turned into a fixed
+     * piece of machine code working on the registers and frame slots in
+     * memory, so the interpreter can leave and enter the code at any
+     * instruction. Arithmetic is only compiled for int32 and float32
+     * operands; guards check the types and leave to the interpreter
+     * when they are something else. Instructions that need the stack or
+     * natives call back into C++, the rest leave to the interpreter.
+     *
+     * A chunk that keeps failing its guards is given back to the
+     * interpreter for good.
+    */
+    class Jit
+    {
+        static const unsigned int HOT_THRESHOLD = 100;
+        static const unsigned int BAILOUT_LIMIT = 64;
+
+        std::vector<JitCode> codes;
+        std::vector<unsigned int> counters;
+        std::vector<unsigned int> bailouts;
+        std::vector<bool> given;    // compiled or given up on
+
+        JitCode compile(const Chunk& chunk);
+        void release(JitCode& code);
+
+        static const Instruction* call_native(JitContext* context, const Instruction* instruction);
+        static const Instruction* get_var(JitContext* context, const Instruction* instruction);
+        static const Instruction* load_const(JitContext* context, const Instruction* instruction);
+        static const Instruction* enter_scope(JitContext* context, const Instruction* instruction);
+        static const Instruction* leave_scope(JitContext* context, const Instruction* instruction);
+        static const Instruction* enter_loop(JitContext* context, const Instruction* instruction);
+        static const Instruction* leave_loop(JitContext* context, const Instruction* instruction);
+        static const Instruction* load_invariant(JitContext* context, const Instruction* instruction);
+        static const Instruction* store_invariant(JitContext* context, const Instruction* instruction);
+
+    public:
+        Jit() = default;
+        Jit(const Jit&) = delete;
+        Jit& operator=(const Jit&) = delete;
+        ~Jit();
+
+        void reset(unsigned int chunkCount);
+        void grow(unsigned int chunkCount);
+        const void* entry(const Chunk& chunk, unsigned int chunkIndex, unsigned int instruction);
+        const Instruction* run(unsigned int chunkIndex, JitContext& context, const void* entry);
+    };
+}
+
+#endif
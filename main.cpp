@@ -5,17 +5,31 @@
 #include <fstream>
 #include <memory>
 #include <cstring>
+#include <cstdlib>
 
 #include "file.hpp"
 #include "diagnostics.hpp"
 #include "tokenizer.hpp"
 #include "parser.hpp"
+#include "resolver.hpp"
+#include "optimizer.hpp"
+#include "typechecker.hpp"
 #include "object.hpp"
 #include "runner.hpp"
+#include "compiler.hpp"
+#include "vm.hpp"
+#include "emitter.hpp"
 
 using namespace pop;
 
 bool DEBUG_MODE = false;
+bool VM_MODE = false;
+bool EMIT_CPP_MODE = false;
+bool JIT_MODE = true;
+unsigned int OPTIMIZE_LEVEL = 1;
+int HOT_THRESHOLD = -1;
+unsigned int DEPTH_LIMIT = RecursionLimit::DEFAULT;
+unsigned int MEMO_CAPACITY = MemoCache::DEFAULT_CAPACITY;
 
 int main(int argc, char** argv)
 {
@@ -25,6 +39,35 @@ int main(int argc, char** argv)
         {
             DEBUG_MODE = true;
         }
+        else if (strcmp("-vm", argv[i]) == 0)
+        {
+            VM_MODE = true;
+        }
+        else if (strcmp("-nojit", argv[i]) == 0)
+        {
+            JIT_MODE = false;
+        }
+        else if (strcmp("--emit-cpp", argv[i]) == 0)
+        {
+            EMIT_CPP_MODE = true;
+        }
+        else if (strncmp("-depth", argv[i], 6) == 0)
+        {
+            DEPTH_LIMIT = atoi(argv[i] + 6);
+        }
+        else if (strncmp("-memo", argv[i], 5) == 0)
+        {
+            // in kilobytes
+            MEMO_CAPACITY = atoi(argv[i] + 5) * 1024;
+        }
+        else if (strncmp("-hot", argv[i], 4) == 0)
+        {
+            HOT_THRESHOLD = atoi(argv[i] + 4);
+        }
+        else if (strncmp("-O", argv[i], 2) == 0)
+        {
+            OPTIMIZE_LEVEL = atoi(argv[i] + 2);
+        }
     }
 
     if (argc == 0)
@@ -33,6 +76,7 @@ int main(int argc, char** argv)
     File file = File(std::string(argv[1]));
 
     Diagnostics diagnostics;
+    diagnostics.set_file(&file);
 
     Tokenizer tokenizer;
     tokenizer.parse_file(&file, &diagnostics);
@@ -49,6 +93,19 @@ int main(int argc, char** argv)
     Parser parser;
     parser.parse_statements(tokenizer.get_tokens(), &diagnostics);
 
+    Resolver resolver;
+    resolver.resolve(parser.get_root(), &diagnostics);
+
+    if (!diagnostics.has_errors())
+    {
+        Optimizer optimizer;
+        optimizer.set_depth_limit(DEPTH_LIMIT);
+        parser.set_root(optimizer.optimize(parser.get_ast(), parser.get_root(), OPTIMIZE_LEVEL, &diagnostics));
+
+        TypeChecker typeChecker;
+        typeChecker.check(parser.get_root(), &diagnostics);
+    }
+
     if (DEBUG_MODE)
         parser.print_ast();
 
@@ -57,9 +114,42 @@ int main(int argc, char** argv)
         diagnostics.dump();
 
     if (diagnostics.has_errors()) return 0;
+
+    // the script is written out as C++ next to itself instead of running
+    if (EMIT_CPP_MODE)
+    {
+        Emitter emitter;
+        std::ofstream output(std::string(argv[1]) + ".cpp");
+        output << emitter.emit(parser.get_root(), &file);
+        return 0;
+    }
     
-    Runner runner;
-    runner.run(parser.get_root(), &diagnostics);
+    if (VM_MODE)
+    {
+        Compiler compiler;
+        Program* program = compiler.compile(parser.get_root());
+
+        if (DEBUG_MODE)
+            compiler.print_program();
+
+        VirtualMachine vm;
+        vm.set_jit_enabled(JIT_MODE);
+        vm.set_depth_limit(DEPTH_LIMIT);
+        vm.set_memo_capacity(MEMO_CAPACITY);
+        vm.run(program, &diagnostics);
+    }
+    else
+    {
+        Runner runner;
+        runner.set_jit_enabled(JIT_MODE);
+        runner.set_depth_limit(DEPTH_LIMIT);
+        runner.set_memo_capacity(MEMO_CAPACITY);
+
+        if (HOT_THRESHOLD >= 0)
+            runner.set_thresholds(HOT_THRESHOLD, HOT_THRESHOLD);
+
+        runner.run(parser.get_root(), &diagnostics);
+    }
 
     // display diagnostics
     if (diagnostics.has_errors() || diagnostics.has_warnings())
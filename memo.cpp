@@ -0,0 +1,195 @@
+#include "memo.hpp"
+
+#include <cstring>
+#include <functional>
+
+using namespace pop;
+
+#pragma region Private Methods
+
+std::size_t MemoCache::hash_of(const Statement* function, const Object* arguments, unsigned int count)
+{
+    std::size_t hash = std::hash<const Statement*>()(function);
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const Object& argument = arguments[i];
+        std::size_t value = 0;
+
+        switch (argument.type)
+        {
+        case ObjectType::INT32:
+            value = std::hash<int>()(argument.int32Value);
+            break;
+        case ObjectType::FLOAT32:
+            {
+                unsigned int bits;
+                std::memcpy(&bits, &argument.float32Value, sizeof(bits));
+                value = std::hash<unsigned int>()(bits);
+            }
+            break;
+        case ObjectType::CHAR:
+            value = std::hash<char>()(argument.charValue);
+            break;
+        case ObjectType::BOOL:
+            value = argument.boolValue;
+            break;
+        case ObjectType::STRING:
+            value = std::hash<std::string>()(argument.as_string());
+            break;
+        case ObjectType::NIL:
+            break;
+        }
+
+        hash = (hash ^ (value + static_cast<std::size_t>(argument.type))) * 1099511628211u;
+    }
+
+    return hash;
+}
+
+/**
+ * If a function sees no difference between two arguments.
+ * Floats are the same if their bits are.
+*/
+bool MemoCache::same(const Object& left, const Object& right)
+{
+    if (left.type != right.type)
+        return false;
+
+    switch (left.type)
+    {
+    case ObjectType::INT32:
+        return left.int32Value == right.int32Value;
+    case ObjectType::FLOAT32:
+        return std::memcmp(&left.float32Value, &right.float32Value, sizeof(float)) == 0;
+    case ObjectType::CHAR:
+        return left.charValue == right.charValue;
+    case ObjectType::BOOL:
+        return left.boolValue == right.boolValue;
+    case ObjectType::STRING:
+        return left.as_string() == right.as_string();
+    case ObjectType::NIL:
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Forgets the least recently used results until at most limit bytes are used.
+*/
+void MemoCache::evict_to(std::size_t limit)
+{
+    while (used > limit && !entries.empty())
+    {
+        auto last = std::prev(entries.end());
+        auto range = index.equal_range(last->hash);
+
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == last)
+            {
+                index.erase(it);
+                break;
+            }
+        }
+
+        used -= last->bytes;
+        entries.pop_back();
+    }
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+MemoCache::MemoCache()
+{
+    capacity = DEFAULT_CAPACITY;
+    used = 0;
+}
+
+void MemoCache::set_capacity(std::size_t bytes)
+{
+    capacity = bytes;
+    evict_to(capacity);
+}
+
+/**
+ * Finds the result of an earlier call with the same arguments.
+*/
+const Object* MemoCache::find(const Statement* function, const Object* arguments, unsigned int count)
+{
+    SI_Function* siFunction = static_cast<SI_Function*>(function->info);
+    ++siFunction->memoLookups;
+
+    auto range = index.equal_range(hash_of(function, arguments, count));
+
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        Entry& entry = *it->second;
+
+        if (entry.function != function)
+            continue;
+
+        unsigned int i = 0;
+
+        while (i < count && same(entry.arguments[i], arguments[i]))
+            ++i;
+
+        if (i < count)
+            continue;
+
+        entries.splice(entries.begin(), entries, it->second);
+        ++siFunction->memoHits;
+        return &entry.result;
+    }
+
+    return nullptr;
+}
+
+/**
+ * Remembers the result of a call. Results too large for the cache are not kept.
+*/
+void MemoCache::insert(const Statement* function, const Object* arguments, unsigned int count, const Object& result)
+{
+    // the list and index nodes, the arguments and the strings they own
+    std::size_t bytes = sizeof(Entry) + 6 * sizeof(void*) + count * sizeof(Object);
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (arguments[i].type == ObjectType::STRING)
+            bytes += sizeof(StringData) + arguments[i].as_string().size();
+    }
+
+    if (result.type == ObjectType::STRING)
+        bytes += sizeof(StringData) + result.as_string().size();
+
+    if (bytes > capacity)
+        return;
+
+    evict_to(capacity - bytes);
+
+    Entry entry;
+    entry.function = function;
+    entry.arguments.assign(arguments, arguments + count);
+    entry.result = result;
+    entry.hash = hash_of(function, arguments, count);
+    entry.bytes = bytes;
+
+    entries.push_front(std::move(entry));
+    index.emplace(entries.front().hash, entries.begin());
+    used += bytes;
+}
+
+/**
+ * Forgets every result.
+*/
+void MemoCache::clear()
+{
+    entries.clear();
+    index.clear();
+    used = 0;
+}
+
+#pragma endregion
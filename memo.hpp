@@ -0,0 +1,73 @@
+#ifndef MEMO
+#define MEMO
+
+#include <cstddef>
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+#include "parser.hpp"
+#include "object.hpp"
+
+namespace pop
+{
+    /**
+     * Remembers the results of pure functions by their arguments.
+     * The resolver decides which functions are worth it, the runner
+     * and the virtual machine look their calls up here first and
+     * add the result of every call that did not fail. A function
+     * whose calls are hardly ever found after a trial period is
+     * not looked up anymore.
+     *
+     * The cache holds roughly as many bytes as its capacity and
+     * forgets the results used least recently to stay below it.
+     * A capacity of zero turns it off.
+    */
+    class MemoCache
+    {
+        /**
+         * The result of one call.
+        */
+        struct Entry
+        {
+            const Statement* function;
+            std::vector<Object> arguments;
+            Object result;
+            std::size_t hash;
+            std::size_t bytes;
+        };
+
+        // the most recently used entry is the first
+        std::list<Entry> entries;
+        std::unordered_multimap<std::size_t, std::list<Entry>::iterator> index;
+        std::size_t capacity;
+        std::size_t used;
+
+        static std::size_t hash_of(const Statement* function, const Object* arguments, unsigned int count);
+        static bool same(const Object& left, const Object& right);
+        void evict_to(std::size_t limit);
+
+    public:
+        static const unsigned int DEFAULT_CAPACITY = 1 << 20;
+        static const unsigned int TRIAL_LOOKUPS = 256;
+
+        /**
+         * If looking up the calls of a function still pays off,
+         * one in eight of them must be found after the trial.
+        */
+        static bool pays_off(const SI_Function& function)
+        {
+            return function.memoLookups < TRIAL_LOOKUPS || function.memoHits * 8 >= function.memoLookups;
+        }
+
+        MemoCache();
+
+        bool enabled() const { return capacity > 0; }
+        void set_capacity(std::size_t bytes);
+        const Object* find(const Statement* function, const Object* arguments, unsigned int count);
+        void insert(const Statement* function, const Object* arguments, unsigned int count, const Object& result);
+        void clear();
+    };
+}
+
+#endif
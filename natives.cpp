@@ -0,0 +1,105 @@
+#include "natives.hpp"
+
+using namespace pop;
+
+#pragma region Builtins
+
+static Object native_print(Object* arguments)
+{
+    std::cout << arguments[0].to_string().as_string() << std::endl;
+    return Object();
+}
+
+static Object native_int(Object* arguments)
+{
+    return arguments[0].to_int32();
+}
+
+static Object native_float(Object* arguments)
+{
+    return arguments[0].to_float32();
+}
+
+static Object native_bool(Object* arguments)
+{
+    return arguments[0].to_bool();
+}
+
+static Object native_char(Object* arguments)
+{
+    return arguments[0].to_char();
+}
+
+static Object native_str(Object* arguments)
+{
+    return arguments[0].to_string();
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+NativeTable::NativeTable()
+{
+    add_native("print", 1, native_print);
+    add_native("int", 1, native_int, true);
+    add_native("float", 1, native_float, true);
+    add_native("bool", 1, native_bool, true);
+    add_native("char", 1, native_char, true);
+    add_native("str", 1, native_str, true);
+}
+
+/**
+ * The native functions shared by the resolver and both engines.
+*/
+NativeTable& NativeTable::global()
+{
+    static NativeTable table;
+    return table;
+}
+
+/**
+ * Adds a native function, replacing any native with the same name.
+ * Returns the index calls to it are bound to.
+*/
+unsigned int NativeTable::add_native(const std::string& name, unsigned int arity, NativeFunction function, bool pure)
+{
+    if (arity > MAX_NATIVE_ARITY)
+        throw std::runtime_error("The native function " + name + " takes too many parameters!");
+
+    if (function == nullptr)
+        throw std::runtime_error("The native function " + name + " has no implementation!");
+
+    Native native;
+    native.name = SymbolTable::global().intern(name);
+    native.arity = arity;
+    native.function = function;
+    native.pure = pure;
+
+    int index = find_native(native.name);
+
+    if (index >= 0)
+    {
+        natives[index] = native;
+        return index;
+    }
+
+    natives.push_back(native);
+    return natives.size() - 1;
+}
+
+/**
+ * Gets the index of a native function or -1 if there is none by that name.
+*/
+int NativeTable::find_native(Symbol name) const
+{
+    for (unsigned int i = 0; i < natives.size(); ++i)
+    {
+        if (natives[i].name == name)
+            return i;
+    }
+
+    return -1;
+}
+
+#pragma endregion
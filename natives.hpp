@@ -0,0 +1,57 @@
+#ifndef NATIVES
+#define NATIVES
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "symbols.hpp"
+#include "object.hpp"
+
+namespace pop
+{
+    // the most arguments a native function can take
+    const unsigned int MAX_NATIVE_ARITY = 8;
+
+    /**
+     * A function implemented in C++. It gets exactly as many
+     * arguments as its arity and reports errors by throwing.
+    */
+    typedef Object (*NativeFunction)(Object* arguments);
+
+    /**
+     * A pure native always gives the same result for the same
+     * arguments and does nothing else, so calls to it with
+     * constant arguments can be folded before the script runs.
+    */
+    struct Native
+    {
+        Symbol name;
+        unsigned int arity;
+        NativeFunction function;
+        bool pure;
+    };
+
+    /**
+     * Every native function a script can call. The resolver binds
+     * calls to them once, so a call never searches by name again.
+     * The builtins are registered when the table is first used,
+     * a host application adds its own with add_native before
+     * the script is resolved.
+    */
+    class NativeTable
+    {
+        std::vector<Native> natives;
+
+        NativeTable();
+
+    public:
+        static NativeTable& global();
+
+        unsigned int add_native(const std::string& name, unsigned int arity, NativeFunction function, bool pure = false);
+        int find_native(Symbol name) const;
+        const Native& get_native(unsigned int index) const { return natives[index]; }
+    };
+}
+
+#endif
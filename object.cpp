@@ -2,43 +2,32 @@
 
 using namespace pop;
 
-Object::Object()
-{
-    this->type = ObjectType::NIL;
-}
-
-Object::Object(ObjectType type, std::shared_ptr<void> value)
-{
-    this->type = type;
-    this->value = value;
-}
-
 void Object::print()
 {
     if (type == ObjectType::INT32)
     {
         std::cout << "Type: " << static_cast<int>(type) << "\n";
-        std::cout << "Result: " << *static_cast<int*>(value.get()) << std::endl;
+        std::cout << "Result: " << int32Value << std::endl;
     }
     else if (type == ObjectType::FLOAT32)
     {
         std::cout << "Type: " << static_cast<int>(type) << "\n";
-        std::cout << "Result: " << *static_cast<float*>(value.get()) << std::endl;
+        std::cout << "Result: " << float32Value << std::endl;
     }
     else if (type == ObjectType::CHAR)
     {
         std::cout << "Type: " << static_cast<int>(type) << "\n";
-        std::cout << "Result: " << *static_cast<char*>(value.get()) << std::endl;
+        std::cout << "Result: " << charValue << std::endl;
     }
     else if (type == ObjectType::BOOL)
     {
         std::cout << "Type: " << static_cast<int>(type) << "\n";
-        std::cout << "Result: " << *static_cast<bool*>(value.get()) << std::endl;
+        std::cout << "Result: " << boolValue << std::endl;
     }
     else if (type == ObjectType::STRING)
     {
         std::cout << "Type: " << static_cast<int>(type) << "\n";
-        std::cout << "Result: " << *static_cast<std::string*>(value.get()) << std::endl;
+        std::cout << "Result: " << as_string() << std::endl;
     }
 }
 
@@ -50,15 +39,15 @@ Object Object::to_int32()
     }
     else if (type == ObjectType::FLOAT32)
     {
-        return Object(ObjectType::INT32, std::make_shared<int>(CAST(CASTS(value, float), int)));
+        return Object::make_int32(CAST(float32Value, int));
     }
     else if (type == ObjectType::CHAR)
     {
-        return Object(ObjectType::INT32, std::make_shared<int>(CAST(CASTS(value, char), int)));
+        return Object::make_int32(CAST(charValue, int));
     }
     else if (type == ObjectType::BOOL)
     {
-        return Object(ObjectType::INT32, std::make_shared<int>(CAST(CASTS(value, bool), int)));
+        return Object::make_int32(CAST(boolValue, int));
     }
     else
     {
@@ -70,7 +59,7 @@ Object Object::to_float32()
 {
     if (type == ObjectType::INT32)
     {
-        return Object(ObjectType::FLOAT32, std::make_shared<float>(CAST(CASTS(value, int), float)));
+        return Object::make_float32(CAST(int32Value, float));
     }
     else if (type == ObjectType::FLOAT32)
     {
@@ -78,11 +67,11 @@ Object Object::to_float32()
     }
     else if (type == ObjectType::CHAR)
     {
-        return Object(ObjectType::FLOAT32, std::make_shared<float>(CAST(CASTS(value, char), float)));
+        return Object::make_float32(CAST(charValue, float));
     }
     else if (type == ObjectType::BOOL)
     {
-        return Object(ObjectType::FLOAT32, std::make_shared<float>(CAST(CASTS(value, bool), float)));
+        return Object::make_float32(CAST(boolValue, float));
     }
     else
     {
@@ -94,11 +83,11 @@ Object Object::to_char()
 {
     if (type == ObjectType::INT32)
     {
-        return Object(ObjectType::CHAR, std::make_shared<char>(CAST(CASTS(value, int), char)));
+        return Object::make_char(CAST(int32Value, char));
     }
     else if (type == ObjectType::FLOAT32)
     {
-        return Object(ObjectType::CHAR, std::make_shared<char>(CAST(CASTS(value, float), char)));
+        return Object::make_char(CAST(float32Value, char));
     }
     else if (type == ObjectType::CHAR)
     {
@@ -106,7 +95,7 @@ Object Object::to_char()
     }
     else if (type == ObjectType::BOOL)
     {
-        return Object(ObjectType::CHAR, std::make_shared<char>(CAST(CASTS(value, bool), char)));
+        return Object::make_char(CAST(boolValue, char));
     }
     else
     {
@@ -118,15 +107,15 @@ Object Object::to_bool()
 {
     if (type == ObjectType::INT32)
     {
-        return Object(ObjectType::BOOL, std::make_shared<bool>(CAST(CASTS(value, int), bool)));
+        return Object::make_bool(CAST(int32Value, bool));
     }
     else if (type == ObjectType::FLOAT32)
     {
-        return Object(ObjectType::BOOL, std::make_shared<bool>(CAST(CASTS(value, float), bool)));
+        return Object::make_bool(CAST(float32Value, bool));
     }
     else if (type == ObjectType::CHAR)
     {
-        return Object(ObjectType::BOOL, std::make_shared<bool>(CAST(CASTS(value, char), bool)));
+        return Object::make_bool(CAST(charValue, bool));
     }
     else if (type == ObjectType::BOOL)
     {
@@ -142,33 +131,33 @@ Object Object::to_string()
 {
     if (type == ObjectType::INT32)
     {
-        std::string str = std::to_string(CASTS(value, int));
-        return Object(ObjectType::STRING, std::make_shared<std::string>(str));
+        std::string str = std::to_string(int32Value);
+        return Object::make_string(str);
     }
     else if (type == ObjectType::FLOAT32)
     {
-        std::string str = std::to_string(CASTS(value, float));
-        return Object(ObjectType::STRING, std::make_shared<std::string>(str));
+        std::string str = std::to_string(float32Value);
+        return Object::make_string(str);
     }
     else if (type == ObjectType::CHAR)
     {
-        std::string str = std::string(1, CASTS(value, char));
-        return Object(ObjectType::STRING, std::make_shared<std::string>(str));
+        std::string str = std::string(1, charValue);
+        return Object::make_string(str);
     }
     else if (type == ObjectType::BOOL)
     {
-        if (*static_cast<bool*>(value.get()))
-            return Object(ObjectType::STRING, std::make_shared<std::string>("true"));
+        if (boolValue)
+            return Object::make_string("true");
 
-        return Object(ObjectType::STRING, std::make_shared<std::string>("false"));
+        return Object::make_string("false");
     }
     else if (type == ObjectType::STRING)
     {
-        return Object(ObjectType::STRING, std::make_shared<std::string>(CASTS(value, std::string)));
+        return *this;
     }
     else if (type == ObjectType::NIL)
     {
-        return Object(ObjectType::STRING, std::make_shared<std::string>("Nil"));
+        return Object::make_string("Nil");
     }
     else
     {
@@ -176,431 +165,171 @@ Object Object::to_string()
     }
 }
 
-Object& Object::operator+(Object& other)
-{
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, int) + CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::FLOAT32;
-            value = std::make_shared<float>(CASTS(value, float) + CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, char) + CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, bool) + CASTS(other.value, bool));
-            return *this;
-        }
-        else if (type == ObjectType::STRING)
-        {
-            type = ObjectType::STRING;
-            value = std::make_shared<std::string>(CASTS(value, std::string) + CASTS(other.value, std::string));
-            return *this;
-        }
-    }
-
-    throw std::runtime_error("Unable to add two objects!");
-}
-
-Object& Object::operator-()
+/**
+ * Negates the object. Returns false if it cannot be negated.
+*/
+bool Object::try_negate()
 {
     if (type == ObjectType::INT32)
     {
-        type = ObjectType::INT32;
-        value = std::make_shared<int>(-1 * CASTS(value, int));
-        return *this;
+        *this = Object::make_int32(-1 * int32Value);
+        return true;
     }
     else if (type == ObjectType::FLOAT32)
     {
-        type = ObjectType::FLOAT32;
-        value = std::make_shared<float>(-1 * CASTS(value, float));
-        return *this;
+        *this = Object::make_float32(-1 * float32Value);
+        return true;
     }
     else if (type == ObjectType::CHAR)
     {
-        type = ObjectType::INT32;
-        value = std::make_shared<int>(-1 * CASTS(value, char));
-        return *this;
+        *this = Object::make_int32(-1 * charValue);
+        return true;
     }
     else if (type == ObjectType::BOOL)
     {
-        type = ObjectType::INT32;
-        value = std::make_shared<int>(-1 * CASTS(value, bool));
-        return *this;
+        *this = Object::make_int32(-1 * boolValue);
+        return true;
     }
 
-    throw std::runtime_error("Unable to negate object!");
+    return false;
 }
 
-Object& Object::operator-(Object& other)
+Object& Object::operator-()
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, int) - CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::FLOAT32;
-            value = std::make_shared<float>(CASTS(value, float) - CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, char) - CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, bool) - CASTS(other.value, bool));
-            return *this;
-        }
-    }
+    if (!try_negate())
+        throw std::runtime_error("Unable to negate object!");
 
-    throw std::runtime_error("Unable to subtract two objects!");
+    return *this;
 }
 
-Object& Object::operator*(Object& other)
-{
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, int) * CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::FLOAT32;
-            value = std::make_shared<float>(CASTS(value, float) * CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, char) * CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, bool) * CASTS(other.value, bool));
-            return *this;
-        }
-    }
+#pragma region Binary Operators
 
-    throw std::runtime_error("Unable to multiply two objects!");
-}
+/**
+ * How to read the value of each type of object.
+ * A new type only needs an entry here and in the
+ * rules of binary_supports.
+*/
+template <ObjectType T>
+struct ObjectValue;
 
-Object& Object::operator/(Object& other)
+template <>
+struct ObjectValue<ObjectType::INT32>
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, int) / CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::FLOAT32;
-            value = std::make_shared<float>(CASTS(value, float) / CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, char) / CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, bool) / CASTS(other.value, bool));
-            return *this;
-        }
-    }
+    static int get(const Object& object) { return object.int32Value; }
+};
 
-    throw std::runtime_error("Unable to divide two objects!");
-}
-
-Object& Object::operator%(Object& other)
+template <>
+struct ObjectValue<ObjectType::FLOAT32>
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, int) % CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, char) % CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::INT32;
-            value = std::make_shared<int>(CASTS(value, bool) % CASTS(other.value, bool));
-            return *this;
-        }
-    }
+    static float get(const Object& object) { return object.float32Value; }
+};
 
-    throw std::runtime_error("Unable to modulo two objects!");
-}
-
-Object& Object::operator==(Object& other)
+template <>
+struct ObjectValue<ObjectType::CHAR>
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, int) == CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, float) == CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, char) == CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, bool) == CASTS(other.value, bool));
-            return *this;
-        }
-        else if (type == ObjectType::STRING)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, std::string) == CASTS(other.value, std::string));
-            return *this;
-        }
-    }
+    static char get(const Object& object) { return object.charValue; }
+};
 
-    throw std::runtime_error("Unable to equals two objects!");
-}
-
-Object& Object::operator!=(Object& other)
+template <>
+struct ObjectValue<ObjectType::NIL>
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, int) != CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, float) != CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, char) != CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, bool) != CASTS(other.value, bool));
-            return *this;
-        }
-        else if (type == ObjectType::STRING)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, std::string) != CASTS(other.value, std::string));
-            return *this;
-        }
-    }
+};
 
-    throw std::runtime_error("Unable to not equals two objects!");
-}
+template <>
+struct ObjectValue<ObjectType::BOOL>
+{
+    static bool get(const Object& object) { return object.boolValue; }
+};
 
-Object& Object::operator>=(Object& other)
+template <>
+struct ObjectValue<ObjectType::STRING>
+{
+    static const std::string& get(const Object& object) { return object.as_string(); }
+};
+
+/**
+ * Wraps the result of an arithmetic operator. Chars and
+ * bools are promoted to int by C++ itself.
+*/
+static Object make_result(int value) { return Object::make_int32(value); }
+static Object make_result(float value) { return Object::make_float32(value); }
+static Object make_result(std::string value) { return Object::make_string(std::move(value)); }
+
+static const char* const BINARY_ERRORS[BINARY_OP_COUNT] = {
+    "Unable to add two objects!",
+    "Unable to subtract two objects!",
+    "Unable to multiply two objects!",
+    "Unable to divide two objects!",
+    "Unable to modulo two objects!",
+    "Unable to equals two objects!",
+    "Unable to not equals two objects!",
+    "Unable to greater than or equals two objects!",
+    "Unable to less than or equals two objects!",
+    "Unable to greather than two objects!",
+    "Unable to less than two objects!"
+};
+
+/**
+ * The kernel of one operator for one pair of operand types.
+*/
+template <BinaryOp Op, ObjectType Left, ObjectType Right>
+static bool binary_kernel(Object& left, const Object& right)
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, int) >= CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, float) >= CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, char) >= CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, bool) >= CASTS(other.value, bool));
-            return *this;
-        }
-        else if (type == ObjectType::STRING)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, std::string) >= CASTS(other.value, std::string));
-            return *this;
-        }
+    if constexpr (Left != Right || !binary_supports(Op, Left))
+    {
+        return false;
+    }
+    else
+    {
+        auto a = ObjectValue<Left>::get(left);
+        auto b = ObjectValue<Right>::get(right);
+
+        if constexpr (Op == BinaryOp::ADD)
+            left = make_result(a + b);
+        else if constexpr (Op == BinaryOp::SUB)
+            left = make_result(a - b);
+        else if constexpr (Op == BinaryOp::MULT)
+            left = make_result(a * b);
+        else if constexpr (Op == BinaryOp::DIV)
+            left = make_result(a / b);
+        else if constexpr (Op == BinaryOp::MOD)
+            left = make_result(a % b);
+        else if constexpr (Op == BinaryOp::EQUALS)
+            left = Object::make_bool(a == b);
+        else if constexpr (Op == BinaryOp::NEQUALS)
+            left = Object::make_bool(a != b);
+        else if constexpr (Op == BinaryOp::GTHANE)
+            left = Object::make_bool(a >= b);
+        else if constexpr (Op == BinaryOp::LTHANE)
+            left = Object::make_bool(a <= b);
+        else if constexpr (Op == BinaryOp::GTHAN)
+            left = Object::make_bool(a > b);
+        else if constexpr (Op == BinaryOp::LTHAN)
+            left = Object::make_bool(a < b);
+
+        return true;
     }
-
-    throw std::runtime_error("Unable to greater than or equals two objects!");
 }
 
-Object& Object::operator<=(Object& other)
+template <unsigned int... Index>
+static constexpr BinaryKernelTable make_binary_kernels(std::integer_sequence<unsigned int, Index...>)
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, int) <= CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, float) <= CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, char) <= CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, bool) <= CASTS(other.value, bool));
-            return *this;
-        }
-        else if (type == ObjectType::STRING)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, std::string) <= CASTS(other.value, std::string));
-            return *this;
-        }
-    }
-
-    throw std::runtime_error("Unable to less than or equals two objects!");
+    return {{ &binary_kernel<
+        CAST(Index / (OBJECT_TYPE_COUNT * OBJECT_TYPE_COUNT), BinaryOp),
+        CAST(Index / OBJECT_TYPE_COUNT % OBJECT_TYPE_COUNT, ObjectType),
+        CAST(Index % OBJECT_TYPE_COUNT, ObjectType)>... }};
 }
 
-Object& Object::operator>(Object& other)
+/**
+ * The message of a type error in a binary operator.
+*/
+const char* Object::binary_error(BinaryOp op)
 {
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, int) > CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, float) > CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, char) > CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, bool) > CASTS(other.value, bool));
-            return *this;
-        }
-        else if (type == ObjectType::STRING)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, std::string) > CASTS(other.value, std::string));
-            return *this;
-        }
-    }
-
-    throw std::runtime_error("Unable to greather than two objects!");
+    return BINARY_ERRORS[CAST(op, int)];
 }
 
-Object& Object::operator<(Object& other)
-{
-    if (type == other.type)
-    {
-        if (type == ObjectType::INT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, int) < CASTS(other.value, int));
-            return *this;
-        }
-        else if (type == ObjectType::FLOAT32)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, float) < CASTS(other.value, float));
-            return *this;
-        }
-        else if (type == ObjectType::CHAR)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, char) < CASTS(other.value, char));
-            return *this;
-        }
-        else if (type == ObjectType::BOOL)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, bool) < CASTS(other.value, bool));
-            return *this;
-        }
-        else if (type == ObjectType::STRING)
-        {
-            type = ObjectType::BOOL;
-            value = std::make_shared<bool>(CASTS(value, std::string) < CASTS(other.value, std::string));
-            return *this;
-        }
-    }
+// built at compile time, one kernel for every operator and pair of types
+const BinaryKernelTable pop::binaryKernels = make_binary_kernels(
+    std::make_integer_sequence<unsigned int, BINARY_OP_COUNT * OBJECT_TYPE_COUNT * OBJECT_TYPE_COUNT>());
 
-    throw std::runtime_error("Unable to less than two objects!");
-}
\ No newline at end of file
+#pragma endregion
@@ -1,22 +1,18 @@
 #ifndef OBJECT
 #define OBJECT
 
-#include <memory>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <stdexcept>
+#include <array>
+#include <utility>
 
 #include "parser.hpp"
 
 // Casts a non-pointer
 #define CAST(value, type) static_cast<type>(value)
 
-// Casts a pointer
-#define CASTP(value, type) *static_cast<type*>(value)
-
-// Casts a shared pointer
-#define CASTS(value, type) *static_cast<type*>(value.get())
-
 namespace pop
 {
     /**
@@ -32,16 +28,126 @@ namespace pop
         STRING
     };
 
+    /**
+     * The binary operators of objects, in the order of the dispatch table.
+    */
+    enum class BinaryOp : char
+    {
+        ADD,
+        SUB,
+        MULT,
+        DIV,
+        MOD,
+        EQUALS,
+        NEQUALS,
+        GTHANE,
+        LTHANE,
+        GTHAN,
+        LTHAN
+    };
+
+    constexpr unsigned int OBJECT_TYPE_COUNT = 6;
+    constexpr unsigned int BINARY_OP_COUNT = 11;
+
+    /**
+     * The operator a binary operator statement applies.
+    */
+    constexpr BinaryOp binary_op_of(StatementType type)
+    {
+        switch (type)
+        {
+        case StatementType::ADD_OP: return BinaryOp::ADD;
+        case StatementType::SUB_OP: return BinaryOp::SUB;
+        case StatementType::MULT_OP: return BinaryOp::MULT;
+        case StatementType::DIV_OP: return BinaryOp::DIV;
+        case StatementType::MOD_OP: return BinaryOp::MOD;
+        case StatementType::EQUALS_OP: return BinaryOp::EQUALS;
+        case StatementType::NEQUALS_OP: return BinaryOp::NEQUALS;
+        case StatementType::GTHANE_OP: return BinaryOp::GTHANE;
+        case StatementType::LTHANE_OP: return BinaryOp::LTHANE;
+        case StatementType::GTHAN_OP: return BinaryOp::GTHAN;
+        case StatementType::LTHAN_OP: return BinaryOp::LTHAN;
+        default: return BinaryOp::ADD;
+        }
+    }
+
+    /**
+     * If an operator works on two objects of the same type.
+    */
+    constexpr bool binary_supports(BinaryOp op, ObjectType type)
+    {
+        switch (op)
+        {
+        case BinaryOp::SUB:
+        case BinaryOp::MULT:
+        case BinaryOp::DIV:
+            return type == ObjectType::INT32 || type == ObjectType::FLOAT32 || type == ObjectType::CHAR || type == ObjectType::BOOL;
+        case BinaryOp::MOD:
+            return type == ObjectType::INT32 || type == ObjectType::CHAR || type == ObjectType::BOOL;
+        default:
+            return type != ObjectType::NIL;
+        }
+    }
+
+    struct Object;
+
+    /**
+     * Applies one binary operator to two objects of known types,
+     * storing the result in the left object. Returns false if
+     * the operator does not work on those types.
+    */
+    typedef bool (*BinaryKernel)(Object& left, const Object& right);
+    typedef std::array<BinaryKernel, BINARY_OP_COUNT * OBJECT_TYPE_COUNT * OBJECT_TYPE_COUNT> BinaryKernelTable;
+
+    /**
+     * The kernels of every operator for every pair of
+     * operand types, indexed by (operator, left, right).
+    */
+    extern const BinaryKernelTable binaryKernels;
+
+    /**
+     * The heap storage behind a string object.
+     * The interpreter is single threaded so the
+     * reference count does not need to be atomic.
+    */
+    struct StringData
+    {
+        unsigned int references;
+        std::string value;
+    };
+
     /**
      * An object that can represents many data types.
+     * Scalars are stored inline, only strings live on the heap.
     */
     struct Object
     {
         ObjectType type;
-        std::shared_ptr<void> value;
+
+        union
+        {
+            int int32Value;
+            float float32Value;
+            char charValue;
+            bool boolValue;
+            StringData* stringValue;
+        };
 
         Object();
-        Object(ObjectType type, std::shared_ptr<void> value);
+        Object(const Object& other);
+        Object(Object&& other) noexcept;
+        ~Object();
+
+        Object& operator=(const Object& other);
+        Object& operator=(Object&& other) noexcept;
+
+        static Object make_int32(int value);
+        static Object make_float32(float value);
+        static Object make_char(char value);
+        static Object make_bool(bool value);
+        static Object make_string(std::string value);
+
+        const std::string& as_string() const;
 
         void print();
 
@@ -51,6 +157,11 @@ namespace pop
         Object to_bool();
         Object to_string();
 
+        Object& apply(BinaryOp op, const Object& other);
+        bool try_apply(BinaryOp op, const Object& other);
+        bool try_negate();
+        static const char* binary_error(BinaryOp op);
+
         Object& operator+(Object& other);
         Object& operator-();
         Object& operator-(Object& other);
@@ -63,7 +174,179 @@ namespace pop
         Object& operator<=(Object& other);
         Object& operator>(Object& other);
         Object& operator<(Object& other);
+
+    private:
+        void retain();
+        void release();
     };
+
+    /**
+     * A literal or folded expression, built once before the script runs.
+    */
+    struct SI_Constant : public StatementInfo
+    {
+        Object value;
+    };
+
+    /**
+     * An expression that does not change while its loop runs. Its value
+     * is kept the first time it is evaluated under the loop's stamp.
+    */
+    struct SI_Invariant : public StatementInfo
+    {
+        SI_Loop* loop = nullptr;
+        unsigned int stamp = 0;
+        Object value;
+    };
+
+    #pragma region Inline Methods
+
+    inline Object::Object()
+    {
+        type = ObjectType::NIL;
+        stringValue = nullptr;
+    }
+
+    inline Object::Object(const Object& other)
+    {
+        type = other.type;
+        stringValue = other.stringValue;
+        retain();
+    }
+
+    inline Object::Object(Object&& other) noexcept
+    {
+        type = other.type;
+        stringValue = other.stringValue;
+        other.type = ObjectType::NIL;
+    }
+
+    inline Object::~Object()
+    {
+        release();
+    }
+
+    inline Object& Object::operator=(const Object& other)
+    {
+        if (this != &other)
+        {
+            Object copy(other);
+            *this = static_cast<Object&&>(copy);
+        }
+
+        return *this;
+    }
+
+    inline Object& Object::operator=(Object&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            type = other.type;
+            stringValue = other.stringValue;
+            other.type = ObjectType::NIL;
+        }
+
+        return *this;
+    }
+
+    /**
+     * Adds a reference to the string payload.
+    */
+    inline void Object::retain()
+    {
+        if (type == ObjectType::STRING)
+            ++stringValue->references;
+    }
+
+    /**
+     * Drops a reference to the string payload.
+    */
+    inline void Object::release()
+    {
+        if (type == ObjectType::STRING && --stringValue->references == 0)
+            delete stringValue;
+    }
+
+    inline Object Object::make_int32(int value)
+    {
+        Object object;
+        object.type = ObjectType::INT32;
+        object.int32Value = value;
+        return object;
+    }
+
+    inline Object Object::make_float32(float value)
+    {
+        Object object;
+        object.type = ObjectType::FLOAT32;
+        object.float32Value = value;
+        return object;
+    }
+
+    inline Object Object::make_char(char value)
+    {
+        Object object;
+        object.type = ObjectType::CHAR;
+        object.charValue = value;
+        return object;
+    }
+
+    inline Object Object::make_bool(bool value)
+    {
+        Object object;
+        object.type = ObjectType::BOOL;
+        object.boolValue = value;
+        return object;
+    }
+
+    inline Object Object::make_string(std::string value)
+    {
+        Object object;
+        object.type = ObjectType::STRING;
+        object.stringValue = new StringData { 1, std::move(value) };
+        return object;
+    }
+
+    inline const std::string& Object::as_string() const
+    {
+        return stringValue->value;
+    }
+
+    /**
+     * Applies a binary operator through the dispatch table.
+     * Leaves the object untouched and returns false on a type error.
+    */
+    inline bool Object::try_apply(BinaryOp op, const Object& other)
+    {
+        unsigned int index = (CAST(op, unsigned int) * OBJECT_TYPE_COUNT + CAST(type, unsigned int)) * OBJECT_TYPE_COUNT + CAST(other.type, unsigned int);
+        return binaryKernels[index](*this, other);
+    }
+
+    /**
+     * Applies a binary operator, throwing on a type error.
+    */
+    inline Object& Object::apply(BinaryOp op, const Object& other)
+    {
+        if (!try_apply(op, other))
+            throw std::runtime_error(binary_error(op));
+
+        return *this;
+    }
+
+    inline Object& Object::operator+(Object& other) { return apply(BinaryOp::ADD, other); }
+    inline Object& Object::operator-(Object& other) { return apply(BinaryOp::SUB, other); }
+    inline Object& Object::operator*(Object& other) { return apply(BinaryOp::MULT, other); }
+    inline Object& Object::operator/(Object& other) { return apply(BinaryOp::DIV, other); }
+    inline Object& Object::operator%(Object& other) { return apply(BinaryOp::MOD, other); }
+    inline Object& Object::operator==(Object& other) { return apply(BinaryOp::EQUALS, other); }
+    inline Object& Object::operator!=(Object& other) { return apply(BinaryOp::NEQUALS, other); }
+    inline Object& Object::operator>=(Object& other) { return apply(BinaryOp::GTHANE, other); }
+    inline Object& Object::operator<=(Object& other) { return apply(BinaryOp::LTHANE, other); }
+    inline Object& Object::operator>(Object& other) { return apply(BinaryOp::GTHAN, other); }
+    inline Object& Object::operator<(Object& other) { return apply(BinaryOp::LTHAN, other); }
+
+    #pragma endregion
 }
 
-#endif
\ No newline at end of file
+#endif
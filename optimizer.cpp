@@ -0,0 +1,872 @@
+#include "optimizer.hpp"
+
+#include <algorithm>
+
+using namespace pop;
+
+#pragma region Private Methods
+
+/**
+ * Turns a statement into a constant. Its children
+ * stay in the Ast but are no longer reachable.
+*/
+void Optimizer::make_constant(Statement& statement, Object value)
+{
+    SI_Constant* siConstant = ast->make_info<SI_Constant>();
+    siConstant->value = value;
+
+    statement.type = StatementType::CONSTANT;
+    statement.info = siConstant;
+    statement.childCount = 0;
+}
+
+/**
+ * Folds a statement and everything below it.
+ * Returns true if the statement is now a constant.
+*/
+bool Optimizer::fold_statement(Statement& statement)
+{
+    if (is_binary_operator(statement.type))
+        return fold_operators(statement);
+
+    // below level 1 only the literals are built
+    bool constantChildren = level > 0;
+
+    for (auto& child : statement.children())
+    {
+        if (!fold_statement(child))
+            constantChildren = false;
+    }
+
+    switch (statement.type)
+    {
+    case StatementType::NUMBER:
+        if (SI_String* siNumber = static_cast<SI_String*>(statement.info))
+        {
+            try
+            {
+                if (siNumber->value.find('.') != std::string::npos)
+                    make_constant(statement, Object::make_float32(std::stof(siNumber->value)));
+                else
+                    make_constant(statement, Object::make_int32(std::stoi(siNumber->value)));
+            }
+            catch (const std::exception& exp)
+            {
+                // the number does not fit, report it when it is evaluated
+            }
+        }
+        break;
+    case StatementType::STRING:
+        if (SI_String* siString = static_cast<SI_String*>(statement.info))
+        {
+            make_constant(statement, Object::make_string(siString->value));
+        }
+        break;
+    case StatementType::CHAR:
+        if (SI_String* siChar = static_cast<SI_String*>(statement.info))
+        {
+            make_constant(statement, Object::make_char(siChar->value[0]));
+        }
+        break;
+    case StatementType::BOOLEAN:
+        if (SI_Boolean* siBoolean = static_cast<SI_Boolean*>(statement.info))
+        {
+            make_constant(statement, Object::make_bool(siBoolean->value));
+        }
+        break;
+    case StatementType::EXP:
+        if (constantChildren)
+        {
+            make_constant(statement, static_cast<SI_Constant*>(statement.children()[0].info)->value);
+        }
+        break;
+    case StatementType::NEGATE_OP:
+        if (constantChildren)
+        {
+            Object value = static_cast<SI_Constant*>(statement.children()[0].info)->value;
+
+            if (value.try_negate())
+                make_constant(statement, value);
+        }
+        break;
+    case StatementType::FUNCTION_CALL:
+        if (SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(statement.info))
+        {
+            if (constantChildren && siFunctionCall->native >= 0)
+                fold_native_call(statement, NativeTable::global().get_native(siFunctionCall->native));
+        }
+        break;
+    default:
+        break;
+    }
+
+    return statement.type == StatementType::CONSTANT;
+}
+
+/**
+ * Folds a chain of operators from its first operand up.
+ * Returns true if the whole chain is now a constant.
+*/
+bool Optimizer::fold_operators(Statement& chain)
+{
+    std::vector<Statement*> operators;
+    bool constant = fold_statement(collect_operator_chain(chain, operators));
+
+    for (auto op = operators.rbegin(); op != operators.rend(); ++op)
+    {
+        bool constantRight = fold_statement((*op)->children()[1]);
+
+        // below level 1 only the literals are built
+        if (level > 0 && constant && constantRight)
+            fold_operator(**op, binary_op_of((*op)->type));
+
+        constant = (*op)->type == StatementType::CONSTANT;
+    }
+
+    return constant;
+}
+
+/**
+ * Folds an operator whose operands are both constants.
+*/
+void Optimizer::fold_operator(Statement& statement, BinaryOp op)
+{
+    Object left = static_cast<SI_Constant*>(statement.children()[0].info)->value;
+    const Object& right = static_cast<SI_Constant*>(statement.children()[1].info)->value;
+
+    // integer division by zero is left for the script to hit
+    if (op == BinaryOp::DIV || op == BinaryOp::MOD)
+    {
+        if ((right.type == ObjectType::INT32 && right.int32Value == 0) ||
+            (right.type == ObjectType::CHAR && right.charValue == 0) ||
+            (right.type == ObjectType::BOOL && !right.boolValue))
+            return;
+    }
+
+    if (left.try_apply(op, right))
+        make_constant(statement, left);
+}
+
+/**
+ * Folds a call to a pure native whose arguments are all constants.
+*/
+void Optimizer::fold_native_call(Statement& nativeCall, const Native& native)
+{
+    if (!native.pure)
+        return;
+
+    Object arguments[MAX_NATIVE_ARITY];
+
+    for (unsigned int i = 0; i < native.arity; ++i)
+        arguments[i] = static_cast<SI_Constant*>(nativeCall.children()[i].info)->value;
+
+    try
+    {
+        make_constant(nativeCall, native.function(arguments));
+    }
+    catch (const std::exception& exp)
+    {
+        // the call fails, report it when it is evaluated
+    }
+}
+
+/**
+ * Finds the name of every variable that is read anywhere
+ * and of every one a function sets by name.
+*/
+void Optimizer::collect_reads(const Statement& statement)
+{
+    if (statement.type == StatementType::VARIABLE)
+        readNames.insert(static_cast<SI_Variable*>(statement.info)->symbol);
+
+    if (statement.type == StatementType::ASSIGN && static_cast<SI_Variable*>(statement.info)->byName)
+        namesSetByName.insert(static_cast<SI_Variable*>(statement.info)->symbol);
+
+    if (is_binary_operator(statement.type))
+    {
+        std::vector<const Statement*> chain;
+        collect_reads(collect_operator_chain(statement, chain));
+
+        for (auto op : chain)
+            collect_reads(op->children()[1]);
+
+        return;
+    }
+
+    for (auto& child : statement.children())
+        collect_reads(child);
+}
+
+/**
+ * Finds the name of every variable assigned below a statement. Functions
+ * defined there are skipped, they only assign to the variables of their
+ * callers by name, which any call can do.
+*/
+void Optimizer::collect_assignments(const Statement& statement, std::unordered_set<Symbol>& assigned)
+{
+    if (statement.type == StatementType::FUNCTION)
+        return;
+
+    if (statement.type == StatementType::ASSIGN)
+        assigned.insert(static_cast<SI_Variable*>(statement.info)->symbol);
+
+    if (statement.type == StatementType::FUNCTION_CALL && static_cast<SI_FunctionCall*>(statement.info)->native < 0)
+        assigned.insert(namesSetByName.begin(), namesSetByName.end());
+
+    if (is_binary_operator(statement.type))
+    {
+        std::vector<const Statement*> chain;
+        collect_assignments(collect_operator_chain(statement, chain), assigned);
+
+        for (auto op : chain)
+            collect_assignments(op->children()[1], assigned);
+
+        return;
+    }
+
+    for (auto& child : statement.children())
+        collect_assignments(child, assigned);
+}
+
+/**
+ * If an expression has no side effects and reads
+ * no variable that is assigned inside the loop.
+*/
+bool Optimizer::is_invariant(const Statement& expression, const Loop& loop) const
+{
+    if (is_binary_operator(expression.type))
+    {
+        std::vector<const Statement*> chain;
+
+        if (!is_invariant(collect_operator_chain(expression, chain), loop))
+            return false;
+
+        for (auto op : chain)
+        {
+            if (!is_invariant(op->children()[1], loop))
+                return false;
+        }
+
+        return true;
+    }
+
+    switch (expression.type)
+    {
+    case StatementType::CONSTANT:
+    case StatementType::NUMBER:
+    case StatementType::STRING:
+    case StatementType::CHAR:
+    case StatementType::BOOLEAN:
+        return true;
+    case StatementType::VARIABLE:
+        return loop.assigned.count(static_cast<SI_Variable*>(expression.info)->symbol) == 0;
+    case StatementType::FUNCTION_CALL:
+        {
+            SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(expression.info);
+
+            if (siFunctionCall->native < 0 || !NativeTable::global().get_native(siFunctionCall->native).pure)
+                return false;
+        }
+        break;
+    case StatementType::EXP:
+    case StatementType::NEGATE_OP:
+        break;
+    default:
+        return false;
+    }
+
+    for (auto& child : expression.children())
+    {
+        if (!is_invariant(child, loop))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * If keeping the value of an expression saves more than reading it again.
+*/
+bool Optimizer::is_worth_hoisting(const Statement& expression) const
+{
+    switch (expression.type)
+    {
+    case StatementType::CONSTANT:
+    case StatementType::NUMBER:
+    case StatementType::STRING:
+    case StatementType::CHAR:
+    case StatementType::BOOLEAN:
+    case StatementType::VARIABLE:
+        return false;
+    case StatementType::EXP:
+        return is_worth_hoisting(expression.children()[0]);
+    default:
+        return true;
+    }
+}
+
+/**
+ * If a statement stores a value nobody reads and storing it cannot fail.
+*/
+bool Optimizer::is_dead_store(const Statement& statement) const
+{
+    if (statement.type != StatementType::ASSIGN)
+        return false;
+
+    if (readNames.count(static_cast<SI_Variable*>(statement.info)->symbol) > 0)
+        return false;
+
+    const Statement* value = &statement.children()[0];
+
+    while (value->type == StatementType::EXP)
+        value = &value->children()[0];
+
+    return value->type == StatementType::CONSTANT || value->type == StatementType::VARIABLE;
+}
+
+/**
+ * If a condition is a constant that is always false.
+*/
+bool Optimizer::is_constant_false(const Statement& condition) const
+{
+    return condition.type == StatementType::CONSTANT && !static_cast<SI_Constant*>(condition.info)->value.boolValue;
+}
+
+/**
+ * Finds every function and the block that defines it.
+*/
+void Optimizer::collect_functions(unsigned int index)
+{
+    const Statement& statement = ast->get(index);
+
+    // expressions define no functions
+    if (statement.type == StatementType::EXP)
+        return;
+
+    for (unsigned int i = 0; i < statement.childCount; ++i)
+    {
+        unsigned int childIndex = index + statement.firstChild + i;
+        const Statement& child = ast->get(childIndex);
+
+        if (statement.type == StatementType::BLOCK && child.type == StatementType::FUNCTION)
+            definitions[static_cast<SI_Function*>(child.info)->functionName].push_back({ childIndex, index });
+
+        collect_functions(childIndex);
+    }
+}
+
+/**
+ * Counts the statements of an expression a function returns.
+ * Expressions that read anything but the parameters or call
+ * user functions are too large to inline.
+*/
+unsigned int Optimizer::inline_size(const Statement& expression) const
+{
+    // nothing but the parameters is declared before the return
+    if (expression.type == StatementType::VARIABLE && static_cast<SI_Variable*>(expression.info)->slot < 0)
+        return INLINE_SIZE + 1;
+
+    if (expression.type == StatementType::FUNCTION_CALL && static_cast<SI_FunctionCall*>(expression.info)->native < 0)
+        return INLINE_SIZE + 1;
+
+    if (is_binary_operator(expression.type))
+    {
+        std::vector<const Statement*> chain;
+        unsigned int size = inline_size(collect_operator_chain(expression, chain));
+
+        for (unsigned int i = 0; i < chain.size() && size <= INLINE_SIZE; ++i)
+            size += 1 + inline_size(chain[i]->children()[1]);
+
+        return size;
+    }
+
+    unsigned int size = 1;
+
+    for (auto& child : expression.children())
+        size += inline_size(child);
+
+    return size;
+}
+
+/**
+ * Finds the function a call is sure to call wherever it runs. It has to
+ * be the only function with its name and be defined by a block around
+ * the call. Returns -1 if the call could find another or none.
+*/
+int Optimizer::find_called(const Statement& functionCall) const
+{
+    SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(functionCall.info);
+
+    if (siFunctionCall->native >= 0)
+        return -1;
+
+    auto definition = definitions.find(siFunctionCall->symbol);
+
+    if (definition == definitions.end() || definition->second.size() != 1)
+        return -1;
+
+    const Definition& found = definition->second[0];
+
+    if (std::find(blocks.begin(), blocks.end(), found.block) == blocks.end())
+        return -1;
+
+    if (static_cast<SI_Function*>(ast->get(found.function).info)->parameterNames.size() != functionCall.childCount)
+        return -1;
+
+    return found.function;
+}
+
+/**
+ * Finds the function a call can be replaced with. Arguments that are
+ * constants or variables can be evaluated as often as they are used.
+ * Returns -1 if the call stays a call.
+*/
+int Optimizer::find_inlined(const Statement& functionCall) const
+{
+    int found = find_called(functionCall);
+
+    if (found < 0)
+        return -1;
+
+    const Statement& body = ast->get(found).children()[0];
+
+    if (body.childCount != 1 || body.children()[0].type != StatementType::RETURN)
+        return -1;
+
+    if (inline_size(body.children()[0].children()[0]) > INLINE_SIZE)
+        return -1;
+
+    for (auto& argument : functionCall.children())
+    {
+        const Statement* value = &argument;
+
+        while (value->type == StatementType::EXP)
+            value = &value->children()[0];
+
+        if (value->type != StatementType::CONSTANT && value->type != StatementType::VARIABLE)
+            return -1;
+    }
+
+    return found;
+}
+
+/**
+ * Works out what a call of a pure function whose arguments are all
+ * constants returns. Fails if the evaluator gives up.
+*/
+bool Optimizer::evaluate_call(const Statement& functionCall, ChildList<const Statement> arguments, Object& result)
+{
+    if (rerunDepth > 0 || mayHaveFailed)
+        return false;
+
+    int function = find_called(functionCall);
+
+    if (function < 0 || !static_cast<SI_Function*>(ast->get(function).info)->pure)
+        return false;
+
+    std::vector<Object> values;
+
+    for (auto& argument : arguments)
+    {
+        const Statement* value = &argument;
+
+        while (value->type == StatementType::EXP)
+            value = &value->children()[0];
+
+        if (value->type != StatementType::CONSTANT)
+            return false;
+
+        values.push_back(static_cast<SI_Constant*>(value->info)->value);
+    }
+
+    return evaluator.evaluate(function, values, result);
+}
+
+/**
+ * Rebuilds a statement at the end of the arena. The arena can grow
+ * while a statement is rebuilt, so statements are passed by index.
+*/
+Statement Optimizer::rebuild(unsigned int index, bool expression)
+{
+    if (is_binary_operator(ast->get(index).type))
+        return rebuild_operators(index, expression);
+
+    if (expression && invariantDepth == 0 && is_worth_hoisting(ast->get(index)))
+    {
+        // the outermost loop the expression does not change in
+        for (unsigned int i = 0; i < loops.size(); ++i)
+        {
+            if (is_invariant(ast->get(index), loops[i]))
+                return hoist(index, i);
+        }
+    }
+
+    switch (ast->get(index).type)
+    {
+    case StatementType::BLOCK:
+        return rebuild_block(index);
+    case StatementType::WHILE:
+        return rebuild_while(index);
+    case StatementType::FUNCTION:
+        return rebuild_function(index);
+    case StatementType::FUNCTION_CALL:
+        return rebuild_call(index, expression);
+    default:
+        return rebuild_children(index);
+    }
+}
+
+/**
+ * Rebuilds a block without its unreachable statements, its
+ * dead stores and the branches that can never be taken.
+*/
+Statement Optimizer::rebuild_block(unsigned int index)
+{
+    Statement block = ast->detach(index);
+    unsigned int mark = pending.size();
+    bool reachable = true;
+    bool failedBefore = mayHaveFailed;
+    blocks.push_back(index);
+
+    for (unsigned int i = 0; i < block.childCount; ++i)
+    {
+        unsigned int childIndex = block.firstChild + i;
+        const Statement& child = ast->get(childIndex);
+
+        // a block stops after a statement that reported an error, only
+        // the first one can start out with an error already reported
+        if (i > 0)
+            mayHaveFailed = false;
+
+        // functions are defined when the block starts, reachable or not
+        if (!reachable && child.type != StatementType::FUNCTION)
+            continue;
+
+        if (is_dead_store(child))
+            continue;
+
+        // a call of a pure function on its own that can be worked out does nothing
+        Object result;
+
+        if (child.type == StatementType::FUNCTION_CALL && evaluate_call(child, child.children(), result))
+            continue;
+
+        if (child.type == StatementType::WHILE && is_constant_false(child.children()[0]))
+            continue;
+
+        if (child.type == StatementType::IF && is_constant_false(child.children()[0]))
+        {
+            // the else branch takes the place of the if
+            if (child.childCount == 3)
+                pending.push_back(rebuild(ast->index_of(child.children()[2]), false));
+
+            continue;
+        }
+
+        if (child.type == StatementType::RETURN || child.type == StatementType::BREAK || child.type == StatementType::CONTINUE)
+            reachable = false;
+
+        pending.push_back(rebuild(childIndex, false));
+    }
+
+    // an else branch after the block starts out like the block did
+    mayHaveFailed = mayHaveFailed || failedBefore;
+
+    blocks.pop_back();
+    ast->add_children(block, pending, mark);
+    return block;
+}
+
+/**
+ * Rebuilds a loop, marking the expressions that do not change inside it.
+*/
+Statement Optimizer::rebuild_while(unsigned int index)
+{
+    Loop loop;
+    loop.info = ast->make_info<SI_Loop>();
+    loop.used = false;
+    collect_assignments(ast->get(index), loop.assigned);
+
+    loops.push_back(loop);
+    ++rerunDepth;
+    Statement whileStmt = rebuild_children(index);
+    --rerunDepth;
+
+    if (loops.back().used)
+        whileStmt.info = loops.back().info;
+
+    loops.pop_back();
+    return whileStmt;
+}
+
+/**
+ * Rebuilds a function. Its body runs in its own frame, whatever loop
+ * it is defined in, so it does not share the enclosing loops.
+*/
+Statement Optimizer::rebuild_function(unsigned int index)
+{
+    std::vector<Loop> enclosingLoops;
+    enclosingLoops.swap(loops);
+
+    ++rerunDepth;
+    Statement function = rebuild_children(index);
+    --rerunDepth;
+
+    loops.swap(enclosingLoops);
+    return function;
+}
+
+/**
+ * Rebuilds a call, inlining it or working it out when it can. What is
+ * left of it may report an error, so no call after it is worked out.
+ * Only calls inside expressions are inlined or worked out, a call on
+ * its own is a statement and has to stay one.
+*/
+Statement Optimizer::rebuild_call(unsigned int index, bool expression)
+{
+    int function = expression ? find_inlined(ast->get(index)) : -1;
+    Statement functionCall = function >= 0 ? inline_call(index, function) : rebuild_children(index);
+
+    if (expression && functionCall.type == StatementType::FUNCTION_CALL)
+    {
+        // the rebuilt arguments are found by their absolute index
+        const Statement* arguments = functionCall.childCount > 0 ? &ast->get(functionCall.firstChild) : nullptr;
+        Object result;
+
+        if (evaluate_call(functionCall, { arguments, functionCall.childCount }, result))
+            make_constant(functionCall, result);
+    }
+
+    if (functionCall.type != StatementType::CONSTANT)
+        mayHaveFailed = true;
+
+    return functionCall;
+}
+
+/**
+ * Rebuilds a statement as it is, rebuilding its children.
+*/
+Statement Optimizer::rebuild_children(unsigned int index)
+{
+    Statement statement = ast->detach(index);
+    unsigned int mark = pending.size();
+
+    for (unsigned int i = 0; i < statement.childCount; ++i)
+    {
+        bool expression;
+
+        switch (statement.type)
+        {
+        case StatementType::BLOCK:
+        case StatementType::ELSE:
+        case StatementType::FUNCTION:
+            expression = false;
+            break;
+        case StatementType::IF:
+        case StatementType::WHILE:
+            expression = i == 0;
+            break;
+        default:
+            expression = true;
+            break;
+        }
+
+        pending.push_back(rebuild(statement.firstChild + i, expression));
+    }
+
+    ast->add_children(statement, pending, mark);
+    return statement;
+}
+
+/**
+ * Rebuilds a chain of operators from its first operand up. An operator
+ * does not change inside a loop when its first operand and the second
+ * operands of every operator up to it do not, so the outermost operator
+ * to hoist, and the outermost loop to hoist it to, are found in a single
+ * walk up the chain for every loop.
+*/
+Statement Optimizer::rebuild_operators(unsigned int index, bool expression)
+{
+    const Statement& outermost = ast->get(index);
+    std::vector<const Statement*> operators;
+    unsigned int first = ast->index_of(collect_operator_chain(outermost, operators));
+
+    // by their index, the arena can grow while the chain is rebuilt
+    std::vector<unsigned int> chain;
+    std::vector<unsigned int> rights;
+
+    for (auto op : operators)
+    {
+        chain.push_back(ast->index_of(*op));
+        rights.push_back(ast->index_of(op->children()[1]));
+    }
+
+    unsigned int hoisted = chain.size();
+    unsigned int hoistedLoop = 0;
+
+    if (invariantDepth == 0)
+    {
+        // only the outermost operator can be rebuilt as something else than an expression
+        unsigned int lowest = expression ? 0 : 1;
+        std::vector<unsigned int> invariantFrom(loops.size(), chain.size());
+
+        for (unsigned int i = 0; i < loops.size(); ++i)
+        {
+            if (!is_invariant(ast->get(first), loops[i]))
+                continue;
+
+            unsigned int from = chain.size();
+
+            while (from > 0 && is_invariant(ast->get(rights[from - 1]), loops[i]))
+                --from;
+
+            invariantFrom[i] = from;
+            hoisted = std::min(hoisted, std::max(from, lowest));
+        }
+
+        while (hoistedLoop < loops.size() && invariantFrom[hoistedLoop] > hoisted)
+            ++hoistedLoop;
+    }
+
+    Statement left = hoisted < chain.size() ? hoist(chain[hoisted], hoistedLoop) : rebuild(first, true);
+
+    for (unsigned int i = std::min<unsigned int>(hoisted, chain.size()); i > 0; --i)
+    {
+        Statement op = ast->detach(chain[i - 1]);
+        unsigned int mark = pending.size();
+
+        pending.push_back(left);
+        pending.push_back(rebuild(rights[i - 1], true));
+        ast->add_children(op, pending, mark);
+
+        left = op;
+    }
+
+    return left;
+}
+
+/**
+ * Wraps an expression in an invariant of a loop.
+*/
+Statement Optimizer::hoist(unsigned int index, unsigned int loop)
+{
+    const Statement& expression = ast->get(index);
+    Statement invariant(StatementType::INVARIANT, expression.lineColumn, expression.lineNumber);
+
+    SI_Invariant* siInvariant = ast->make_info<SI_Invariant>();
+    siInvariant->loop = loops[loop].info;
+    invariant.info = siInvariant;
+    loops[loop].used = true;
+
+    ++invariantDepth;
+    unsigned int mark = pending.size();
+    pending.push_back(rebuild(index, false));
+    ast->add_children(invariant, pending, mark);
+    --invariantDepth;
+
+    return invariant;
+}
+
+/**
+ * Replaces a call with the expression the function returns.
+ * Constant arguments can turn it into a constant.
+*/
+Statement Optimizer::inline_call(unsigned int index, unsigned int function)
+{
+    const Statement& functionCall = ast->get(index);
+    std::vector<unsigned int> arguments;
+
+    for (unsigned int i = 0; i < functionCall.childCount; ++i)
+    {
+        unsigned int argument = index + functionCall.firstChild + i;
+
+        while (ast->get(argument).type == StatementType::EXP)
+            argument += ast->get(argument).firstChild;
+
+        arguments.push_back(argument);
+    }
+
+    const Statement& returnStmt = ast->get(function).children()[0].children()[0];
+    unsigned int expression = ast->index_of(returnStmt.children()[0]);
+
+    Statement inlined(StatementType::INLINE, returnStmt.lineColumn, returnStmt.lineNumber);
+    SI_Symbol* siInline = ast->make_info<SI_Symbol>();
+    siInline->symbol = static_cast<SI_Function*>(ast->get(function).info)->functionName;
+    inlined.info = siInline;
+
+    unsigned int mark = pending.size();
+    pending.push_back(substitute(expression, arguments));
+    ast->add_children(inlined, pending, mark);
+
+    Statement& value = ast->get(inlined.firstChild);
+
+    if (fold_statement(value))
+        make_constant(inlined, static_cast<SI_Constant*>(value.info)->value);
+
+    return inlined;
+}
+
+/**
+ * Copies an inlined expression with the arguments in place of the parameters.
+*/
+Statement Optimizer::substitute(unsigned int index, const std::vector<unsigned int>& arguments)
+{
+    if (ast->get(index).type == StatementType::VARIABLE)
+        return rebuild(arguments[static_cast<SI_Variable*>(ast->get(index).info)->slot], true);
+
+    Statement statement = ast->detach(index);
+    unsigned int mark = pending.size();
+
+    for (unsigned int i = 0; i < statement.childCount; ++i)
+        pending.push_back(substitute(statement.firstChild + i, arguments));
+
+    ast->add_children(statement, pending, mark);
+    return statement;
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+/**
+ * Optimizes a resolved tree and returns its new root.
+*/
+Statement* Optimizer::optimize(Ast* ast, Statement* root, unsigned int level, Diagnostics* diagnostics)
+{
+    this->ast = ast;
+    this->level = level;
+
+    fold_statement(*root);
+
+    if (level == 0)
+        return root;
+
+    pending.clear();
+    loops.clear();
+    readNames.clear();
+    namesSetByName.clear();
+    invariantDepth = 0;
+    definitions.clear();
+    blocks.clear();
+    rerunDepth = 0;
+    mayHaveFailed = false;
+    collect_reads(*root);
+    collect_functions(ast->index_of(*root));
+
+    evaluator.reset(ast);
+
+    for (auto& definition : definitions)
+    {
+        if (definition.second.size() == 1)
+            evaluator.add_function(definition.first, definition.second[0].function);
+    }
+
+    root = ast->add_root(rebuild(ast->index_of(*root), false));
+
+    Resolver resolver;
+    resolver.resolve(root, diagnostics);
+
+    return root;
+}
+
+#pragma endregion
@@ -0,0 +1,122 @@
+#ifndef OPTIMIZER
+#define OPTIMIZER
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+
+#include "parser.hpp"
+#include "object.hpp"
+#include "natives.hpp"
+#include "resolver.hpp"
+#include "evaluator.hpp"
+
+namespace pop
+{
+    /**
+     * Rewrites the resolved statements before they run. Literals are
+     * always turned into constants holding their prebuilt object, so
+     * nothing is parsed or allocated for them while the script runs.
+     *
+     * From level 1 on, expressions made only of constants are folded,
+     * and the tree is rebuilt without unreachable statements or stores
+     * to variables that are never read, with expressions that do not
+     * change inside a loop marked as invariants of that loop. The
+     * rebuilt tree is resolved again.
+     *
+     * Calls of small functions that only return an expression are
+     * inlined when the call is sure to find the function and every
+     * argument is a constant or a variable. The expression takes the
+     * place of the call with the arguments in place of the parameters,
+     * wrapped in an INLINE statement at the location of the function's
+     * return, which reports errors there and evaluates to nil like the
+     * call did.
+     *
+     * Other calls of pure functions whose arguments are all constants
+     * are worked out by the evaluator and become the constant they
+     * return. Only calls that run once, before anything could have
+     * reported an error, are worked out, since a function only gets as
+     * far as its first statement after an error. Those are the calls
+     * outside of loops and functions with no other call before them
+     * in their statement.
+     *
+     * Nothing that could report an error is removed or moved, so
+     * errors are still reported when, and if, they are reached.
+    */
+    class Optimizer
+    {
+        /**
+         * A loop being rebuilt and every variable assigned inside it.
+        */
+        struct Loop
+        {
+            SI_Loop* info;
+            std::unordered_set<Symbol> assigned;
+            bool used;
+        };
+
+        /**
+         * A function and the block that defines it, by their index in the Ast.
+        */
+        struct Definition
+        {
+            unsigned int function;
+            unsigned int block;
+        };
+
+        // the most statements an inlined expression can have
+        static const unsigned int INLINE_SIZE = 16;
+
+        Ast* ast;
+        unsigned int level;
+        std::vector<Statement> pending;
+        std::vector<Loop> loops;
+        std::unordered_set<Symbol> readNames;
+        std::unordered_set<Symbol> namesSetByName;
+        unsigned int invariantDepth;
+        std::unordered_map<Symbol, std::vector<Definition>> definitions;
+        std::vector<unsigned int> blocks;
+        Evaluator evaluator;
+        // loops and functions around the statement being rebuilt
+        unsigned int rerunDepth;
+        // if a call of the statement being rebuilt could have reported an error
+        bool mayHaveFailed;
+
+        void make_constant(Statement& statement, Object value);
+        bool fold_statement(Statement& statement);
+        bool fold_operators(Statement& chain);
+        void fold_operator(Statement& statement, BinaryOp op);
+        void fold_native_call(Statement& nativeCall, const Native& native);
+
+        void collect_reads(const Statement& statement);
+        void collect_assignments(const Statement& statement, std::unordered_set<Symbol>& assigned);
+        bool is_invariant(const Statement& expression, const Loop& loop) const;
+        bool is_worth_hoisting(const Statement& expression) const;
+        bool is_dead_store(const Statement& statement) const;
+        bool is_constant_false(const Statement& condition) const;
+
+        void collect_functions(unsigned int index);
+        unsigned int inline_size(const Statement& expression) const;
+        int find_called(const Statement& functionCall) const;
+        int find_inlined(const Statement& functionCall) const;
+        bool evaluate_call(const Statement& functionCall, ChildList<const Statement> arguments, Object& result);
+
+        Statement rebuild(unsigned int index, bool expression);
+        Statement rebuild_block(unsigned int index);
+        Statement rebuild_while(unsigned int index);
+        Statement rebuild_function(unsigned int index);
+        Statement rebuild_call(unsigned int index, bool expression);
+        Statement rebuild_children(unsigned int index);
+        Statement rebuild_operators(unsigned int index, bool expression);
+        Statement hoist(unsigned int index, unsigned int loop);
+        Statement inline_call(unsigned int index, unsigned int function);
+        Statement substitute(unsigned int index, const std::vector<unsigned int>& arguments);
+
+    public:
+        void set_depth_limit(unsigned int limit) { evaluator.set_depth_limit(limit); }
+        Statement* optimize(Ast* ast, Statement* root, unsigned int level, Diagnostics* diagnostics);
+    };
+}
+
+#endif
@@ -1,17 +1,100 @@
 #include "parser.hpp"
+#include "object.hpp"
 
 using namespace pop;
 
+unsigned int SI_Loop::lastStamp = 0;
+
 #pragma region Statement
 
-Statement::Statement() { }
+Statement::Statement()
+{
+    info = nullptr;
+    firstChild = 0;
+    childCount = 0;
+    lineColumn = 0;
+    lineNumber = 0;
+    type = StatementType::ERROR;
+    specialization = Specialization::NONE;
+}
 
-Statement::Statement(StatementType type, std::string line, unsigned int lineColumn, unsigned int lineNumber)
+Statement::Statement(StatementType type, unsigned int lineColumn, unsigned int lineNumber)
 {
-    this->type = type;
-    this->line = line;
+    this->info = nullptr;
+    this->firstChild = 0;
+    this->childCount = 0;
     this->lineColumn = lineColumn;
     this->lineNumber = lineNumber;
+    this->type = type;
+    this->specialization = Specialization::NONE;
+}
+
+#pragma endregion
+
+#pragma region Ast
+
+/**
+ * Copies a finished statement to the end of the arena. Its children
+ * are already there, their absolute index becomes an offset from it.
+*/
+unsigned int Ast::append(const Statement& statement)
+{
+    unsigned int position = statements.size();
+    statements.push_back(statement);
+
+    if (statement.childCount > 0)
+        statements.back().firstChild = statement.firstChild - static_cast<int>(position);
+
+    return position;
+}
+
+/**
+ * Moves the pending statements from mark on into the arena
+ * as the children of the parent.
+*/
+void Ast::add_children(Statement& parent, std::vector<Statement>& pending, unsigned int mark)
+{
+    parent.firstChild = statements.size();
+    parent.childCount = pending.size() - mark;
+
+    for (unsigned int i = mark; i < pending.size(); ++i)
+        append(pending[i]);
+
+    pending.resize(mark);
+}
+
+/**
+ * Adds the statement everything else hangs from.
+*/
+Statement* Ast::add_root(const Statement& root)
+{
+    return &statements[append(root)];
+}
+
+/**
+ * Copies a statement out of the arena so it can be rebuilt.
+ * Its children are left where they are and found by their
+ * absolute index until the copy is given children of its own.
+*/
+Statement Ast::detach(unsigned int index) const
+{
+    Statement statement = statements[index];
+    statement.firstChild += static_cast<int>(index);
+    return statement;
+}
+
+void Ast::clear()
+{
+    statements.clear();
+    infos.clear();
+}
+
+/**
+ * Gets the number of statements in the arena.
+*/
+unsigned int Ast::get_size() const
+{
+    return statements.size();
 }
 
 #pragma endregion
@@ -42,34 +125,37 @@ void Parser::move_back()
     --index;
 }
 
+// stands in for tokens past either end of the list
+static const Token ERROR_TOKEN("ERROR", TokenType::ERROR, "", 0, 0);
+
 /**
  * Looks at the current token.
 */
-Token Parser::get()
+const Token& Parser::get() const
 {
     if (index >= tokens->size())
-        return Token("ERROR", TokenType::ERROR, "", 0, 0);
-    return tokens->at(index);
+        return ERROR_TOKEN;
+    return (*tokens)[index];
 }
 
 /**
  * Looks at the previous token.
 */
-Token Parser::prev()
+const Token& Parser::prev() const
 {
-    if (index - 1 < 0 || index - 1 >= tokens->size())
-        return Token("ERROR", TokenType::ERROR, "", 0, 0);
-    return tokens->at(index - 1);
+    if (index == 0 || index - 1 >= tokens->size())
+        return ERROR_TOKEN;
+    return (*tokens)[index - 1];
 }
 
 /**
  * Looks at the next token.
 */
-Token Parser::next()
+const Token& Parser::next() const
 {
     if (index + 1 >= tokens->size())
-        return Token("ERROR", TokenType::ERROR, "", 0, 0);
-    return tokens->at(index + 1);
+        return ERROR_TOKEN;
+    return (*tokens)[index + 1];
 }
 
 #pragma region Statements
@@ -79,19 +165,19 @@ Statement Parser::parse_next_statement()
     // VARIABLE ASSIGNMENT
     if (get().type == TokenType::WORD && next().type == TokenType::ASSIGNMENT)
     {
-        Statement assignment(StatementType::ASSIGN, get().line, get().lineColumn, get().lineNumber);
-        std::shared_ptr<SI_String> siAssign = std::make_shared<SI_String>();
+        Statement assignment(StatementType::ASSIGN, get().lineColumn, get().lineNumber);
+        SI_Variable* siAssign = ast.make_info<SI_Variable>();
         assignment.info = siAssign;
         
         // set the variable name
-        siAssign->value = get().value; 
+        siAssign->symbol = get().symbol;
 
         move_next();
         move_next(); // skip the =
 
-        Statement expression = parse_expression();
-
-        assignment.children.push_back(expression);
+        unsigned int mark = pending.size();
+        pending.push_back(parse_expression());
+        ast.add_children(assignment, pending, mark);
 
         --index;
 
@@ -120,33 +206,48 @@ Statement Parser::parse_next_statement()
     // RETURN STATEMENT
     else if (get().type == TokenType::RETURN)
     {
-        Statement statement(StatementType::RETURN, get().line, get().lineColumn, get().lineNumber);
+        if (functionDepth == 0)
+            diagnostics->add_error("Cannot return here.", get().line, get().lineColumn, get().lineNumber);
+
+        Statement statement(StatementType::RETURN, get().lineColumn, get().lineNumber);
         move_next();
-        statement.children.push_back(parse_expression());
+
+        unsigned int mark = pending.size();
+        pending.push_back(parse_expression());
+        ast.add_children(statement, pending, mark);
+
+        --index;
+
         return statement;
     }
     // BREAK STATEMENT
     else if (get().type == TokenType::BREAK)
     {
-        return Statement(StatementType::BREAK, get().line, get().lineColumn, get().lineNumber);
+        if (loopDepth == 0)
+            diagnostics->add_error("Cannot break here.", get().line, get().lineColumn, get().lineNumber);
+
+        return Statement(StatementType::BREAK, get().lineColumn, get().lineNumber);
     }
     // CONTINUE STATEMENT
     else if (get().type == TokenType::CONTINUE)
     {
-        return Statement(StatementType::CONTINUE, get().line, get().lineColumn, get().lineNumber);
+        if (loopDepth == 0)
+            diagnostics->add_error("Cannot continue here.", get().line, get().lineColumn, get().lineNumber);
+
+        return Statement(StatementType::CONTINUE, get().lineColumn, get().lineNumber);
     }
     else if (get().type != TokenType::EOL && get().type != TokenType::_EOF)
     {
         diagnostics->add_error("Bad statement!", get().line, get().lineColumn, get().lineNumber);
     }
 
-    return Statement(StatementType::ERROR, get().line, get().lineColumn, get().lineNumber);
+    return Statement(StatementType::ERROR, get().lineColumn, get().lineNumber);
 }
 
 Statement Parser::parse_function()
 {
-    Statement function(StatementType::FUNCTION, get().line, get().lineColumn, get().lineNumber);
-    std::shared_ptr<SI_Function> siFunction = std::make_shared<SI_Function>();
+    Statement function(StatementType::FUNCTION, get().lineColumn, get().lineNumber);
+    SI_Function* siFunction = ast.make_info<SI_Function>();
     function.info = siFunction;
 
     move_next(); // skip the func keyword
@@ -155,7 +256,7 @@ Statement Parser::parse_function()
         diagnostics->add_error("Function name is not specified!", get().line, get().lineColumn, get().lineNumber);
 
     // set the name of the function
-    siFunction->functionName = get().value;
+    siFunction->functionName = get().symbol;
 
     move_next();
 
@@ -183,7 +284,7 @@ Statement Parser::parse_function()
                 break;
             }
 
-            siFunction->parameterNames.push_back(get().value);
+            siFunction->parameterNames.push_back(get().symbol);
             move_next();
 
             if (get().type != TokenType::COMMA && get().type != TokenType::CLOSE_PARAN)
@@ -199,30 +300,42 @@ Statement Parser::parse_function()
     while (get().type == TokenType::EOL)
         move_next();
 
-    function.children.push_back(parse_block());
+    // loops do not reach into the function body
+    unsigned int enclosingLoopDepth = loopDepth;
+    loopDepth = 0;
+    ++functionDepth;
+
+    unsigned int mark = pending.size();
+    pending.push_back(parse_block());
+    ast.add_children(function, pending, mark);
+
+    --functionDepth;
+    loopDepth = enclosingLoopDepth;
 
     return function;
 }
 
 Statement Parser::parse_function_call()
 {
-    Statement functionCall(StatementType::FUNCTION_CALL, get().line, get().lineColumn, get().lineNumber);
-    std::shared_ptr<SI_String> siFunctionCall = std::make_shared<SI_String>();
+    Statement functionCall(StatementType::FUNCTION_CALL, get().lineColumn, get().lineNumber);
+    SI_FunctionCall* siFunctionCall = ast.make_info<SI_FunctionCall>();
     functionCall.info = siFunctionCall;
 
     // set the name of the function to be called
-    siFunctionCall->value = get().value;
+    siFunctionCall->symbol = get().symbol;
 
     move_next();
     move_next(); // pass the open parenthesis
 
+    unsigned int mark = pending.size();
+
     // parse the function calls parameters
     while (!eof() && get().type != TokenType::CLOSE_PARAN)
     {
         if (get().type == TokenType::COMMA)
             move_next();
 
-        functionCall.children.push_back(parse_expression());
+        pending.push_back(parse_expression());
 
         if (get().type != TokenType::COMMA && get().type != TokenType::CLOSE_PARAN)
         {
@@ -231,22 +344,28 @@ Statement Parser::parse_function_call()
         }
     }
 
+    ast.add_children(functionCall, pending, mark);
+
     return functionCall;
 }
 
 Statement Parser::parse_if()
 {
-    Statement ifStmt(StatementType::IF, get().line, get().lineColumn, get().lineNumber);
+    Statement ifStmt(StatementType::IF, get().lineColumn, get().lineNumber);
 
     move_next(); // move to the start of the if's expression
 
-    ifStmt.children.push_back(parse_expression());
+    unsigned int mark = pending.size();
+    pending.push_back(parse_expression());
 
     // find the ifs block
     while (get().type == TokenType::EOL)
         move_next();
 
-    ifStmt.children.push_back(parse_block());
+    pending.push_back(parse_block());
+
+    // remember the closing } in case there is no else
+    unsigned int blockEnd = index;
 
     // move to the next token passing end of lines
     move_next();
@@ -258,19 +377,25 @@ Statement Parser::parse_if()
     if (get().type == TokenType::ELSE && next().type == TokenType::IF)
     {
         move_next(); // pass the else token
-        ifStmt.children.push_back(parse_if());
+        pending.push_back(parse_if());
     }
     else if (get().type == TokenType::ELSE)
     {
-        ifStmt.children.push_back(parse_else());
+        pending.push_back(parse_else());
+    }
+    else
+    {
+        index = blockEnd;
     }
 
+    ast.add_children(ifStmt, pending, mark);
+
     return ifStmt;
 }
 
 Statement Parser::parse_else()
 {
-    Statement _else(StatementType::ELSE, get().line, get().lineColumn, get().lineNumber);
+    Statement _else(StatementType::ELSE, get().lineColumn, get().lineNumber);
 
     // find the elses block
     move_next();
@@ -278,24 +403,31 @@ Statement Parser::parse_else()
     while (get().type == TokenType::EOL)
         move_next();
 
-    _else.children.push_back(parse_block());
+    unsigned int mark = pending.size();
+    pending.push_back(parse_block());
+    ast.add_children(_else, pending, mark);
 
     return _else;
 }
 
 Statement Parser::parse_while()
 {
-    Statement whileStmt(StatementType::WHILE, get().line, get().lineColumn, get().lineNumber);
+    Statement whileStmt(StatementType::WHILE, get().lineColumn, get().lineNumber);
 
     move_next(); // move to the start of the while's expression
 
-    whileStmt.children.push_back(parse_expression());
+    unsigned int mark = pending.size();
+    pending.push_back(parse_expression());
 
     // find the whiles block
     while (get().type == TokenType::EOL)
         move_next();
 
-    whileStmt.children.push_back(parse_block());
+    ++loopDepth;
+    pending.push_back(parse_block());
+    --loopDepth;
+
+    ast.add_children(whileStmt, pending, mark);
 
     return whileStmt;
 }
@@ -305,19 +437,24 @@ Statement Parser::parse_block()
     if (get().type != TokenType::OPEN_CURL)
         diagnostics->add_error("Missing { for block!", get().line, get().lineColumn, get().lineNumber);
 
-    Statement block(StatementType::BLOCK, get().line, get().lineColumn, get().lineNumber);
+    Statement block(StatementType::BLOCK, get().lineColumn, get().lineNumber);
+    block.info = ast.make_info<SI_Block>();
     move_next();
 
+    unsigned int mark = pending.size();
+
     while (!eof() && get().type != TokenType::CLOSE_CURL)
     {
         Statement statement = parse_next_statement();
 
         if (statement.type != StatementType::ERROR)
-            block.children.push_back(statement);
+            pending.push_back(statement);
 
         move_next();
     }
 
+    ast.add_children(block, pending, mark);
+
     if (get().type != TokenType::CLOSE_CURL)
         diagnostics->add_error("Missing } for block!", get().line, get().lineColumn, get().lineNumber);
 
@@ -331,8 +468,23 @@ Statement Parser::parse_block()
 
 Statement Parser::parse_expression()
 {
-    Statement expression(StatementType::EXP, get().line, get().lineColumn, get().lineNumber);
-    expression.children.push_back(parse_boolean_operators());
+    Statement expression(StatementType::EXP, get().lineColumn, get().lineNumber);
+
+    if (termDepth == 0)
+        tooDeep = false;
+
+    unsigned int mark = pending.size();
+    pending.push_back(parse_boolean_operators());
+
+    // nothing past the parser gets to see an expression this deep
+    if (termDepth == 0 && tooDeep)
+    {
+        pending.resize(mark);
+        return Statement(StatementType::ERROR, expression.lineColumn, expression.lineNumber);
+    }
+
+    ast.add_children(expression, pending, mark);
+
     return expression;
 }
 
@@ -350,60 +502,84 @@ Statement Parser::parse_boolean_operators()
         if (get().type == TokenType::EQUALS)
         {
             move_next();
-            Statement newLeft(StatementType::EQUALS_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::EQUALS_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_add_sub());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_add_sub());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::NEQUALS)
         {
             move_next();
-            Statement newLeft(StatementType::NEQUALS_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::NEQUALS_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_add_sub());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_add_sub());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::GTHANE)
         {
             move_next();
-            Statement newLeft(StatementType::GTHANE_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::GTHANE_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_add_sub());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_add_sub());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::LTHANE)
         {
             move_next();
-            Statement newLeft(StatementType::LTHANE_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::LTHANE_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_add_sub());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_add_sub());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::GTHAN)
         {
             move_next();
-            Statement newLeft(StatementType::GTHAN_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::GTHAN_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_add_sub());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_add_sub());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::LTHAN)
         {
             move_next();
-            Statement newLeft(StatementType::LTHAN_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::LTHAN_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_add_sub());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_add_sub());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
@@ -421,20 +597,28 @@ Statement Parser::parse_add_sub()
         if (get().type == TokenType::PLUS)
         {
             move_next();
-            Statement newLeft(StatementType::ADD_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::ADD_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_mult_div_mod());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_mult_div_mod());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::SUB)
         {
             move_next();
-            Statement newLeft(StatementType::SUB_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::SUB_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_mult_div_mod());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_mult_div_mod());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
@@ -452,30 +636,42 @@ Statement Parser::parse_mult_div_mod()
         if (get().type == TokenType::MULT)
         {
             move_next();
-            Statement newLeft(StatementType::MULT_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::MULT_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_term());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_term());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::DIV)
         {
             move_next();
-            Statement newLeft(StatementType::DIV_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::DIV_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_term());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_term());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
         else if (get().type == TokenType::MOD)
         {
             move_next();
-            Statement newLeft(StatementType::MOD_OP, get().line, get().lineColumn, get().lineNumber);
+            Statement newLeft(StatementType::MOD_OP, get().lineColumn, get().lineNumber);
 
-            newLeft.children.push_back(left);
-            newLeft.children.push_back(parse_term());
+            unsigned int mark = pending.size();
+            pending.push_back(left);
+            ++termDepth;
+            pending.push_back(parse_term());
+            --termDepth;
+            ast.add_children(newLeft, pending, mark);
 
             left = newLeft;
         }
@@ -486,12 +682,17 @@ Statement Parser::parse_mult_div_mod()
 
 Statement Parser::parse_term()
 {
-    Statement result(StatementType::ERROR, get().line, get().lineColumn, get().lineNumber);
+    Statement result(StatementType::ERROR, get().lineColumn, get().lineNumber);
 
     if (get().type == TokenType::OPEN_PARAN)
     {
+        if (termDepth >= MAX_EXPRESSION_DEPTH)
+            return skip_deep_expression();
+
         move_next();
+        ++termDepth;
         Statement expression = parse_expression();
+        --termDepth;
 
         if (get().type != TokenType::CLOSE_PARAN)
             diagnostics->add_error("Missing a )!", get().line, get().lineColumn, get().lineNumber);
@@ -501,55 +702,69 @@ Statement Parser::parse_term()
     }
     else if (get().type == TokenType::NUMBER)
     {
-        std::shared_ptr<SI_String> siString = std::make_shared<SI_String>();
-        siString->value = get().value;
+        SI_String* siString = ast.make_info<SI_String>();
+        siString->value = std::string(get().value);
         result.info = siString;
         result.type = StatementType::NUMBER;
     }
     else if (get().type == TokenType::CHAR)
     {
-        std::shared_ptr<SI_String> siString = std::make_shared<SI_String>();
-        siString->value = get().value;
+        SI_String* siString = ast.make_info<SI_String>();
+        siString->value = std::string(get().value);
         result.info = siString;
         result.type = StatementType::CHAR;
     }
     else if (get().type == TokenType::WORD && next().type == TokenType::OPEN_PARAN)
     {
+        if (termDepth >= MAX_EXPRESSION_DEPTH)
+            return skip_deep_expression();
+
+        ++termDepth;
         result = parse_function_call();
+        --termDepth;
     }
     else if (get().type == TokenType::WORD)
     {
-        std::shared_ptr<SI_String> siString = std::make_shared<SI_String>();
-        siString->value = get().value;
-        result.info = siString;
+        SI_Variable* siVariable = ast.make_info<SI_Variable>();
+        siVariable->symbol = get().symbol;
+        result.info = siVariable;
         result.type = StatementType::VARIABLE;
     }
     else if (get().type == TokenType::TRUE)
     {
-        std::shared_ptr<SI_Boolean> siBoolean = std::make_shared<SI_Boolean>();
+        SI_Boolean* siBoolean = ast.make_info<SI_Boolean>();
         siBoolean->value = true;
         result.info = siBoolean;
         result.type = StatementType::BOOLEAN;
     }
     else if (get().type == TokenType::FALSE)
     {
-        std::shared_ptr<SI_Boolean> siBoolean = std::make_shared<SI_Boolean>();
+        SI_Boolean* siBoolean = ast.make_info<SI_Boolean>();
         siBoolean->value = false;
         result.info = siBoolean;
         result.type = StatementType::BOOLEAN;
     }
     else if (get().type == TokenType::STRING)
     {
-        std::shared_ptr<SI_String> siString = std::make_shared<SI_String>();
-        siString->value = get().value;
+        SI_String* siString = ast.make_info<SI_String>();
+        siString->value = std::string(get().value);
         result.info = siString;
         result.type = StatementType::STRING;
     }
     else if (get().type == TokenType::SUB)
     {
+        if (termDepth >= MAX_EXPRESSION_DEPTH)
+            return skip_deep_expression();
+
         move_next();
         result.type = StatementType::NEGATE_OP;
-        result.children.push_back(parse_term());
+
+        unsigned int mark = pending.size();
+        ++termDepth;
+        pending.push_back(parse_term());
+        --termDepth;
+        ast.add_children(result, pending, mark);
+
         return result;
     }
 
@@ -561,13 +776,100 @@ Statement Parser::parse_term()
     return result;
 }
 
+/**
+ * Reports a term nested too deep to parse and skips to the end
+ * of the expression it is in, so the enclosing expressions
+ * can be parsed. The outermost one is then dropped.
+*/
+Statement Parser::skip_deep_expression()
+{
+    Statement result(StatementType::ERROR, get().lineColumn, get().lineNumber);
+    diagnostics->add_error("That expression is nested way too deep!", get().line, get().lineColumn, get().lineNumber);
+    tooDeep = true;
+
+    int parentheses = 0;
+
+    while (!eof())
+    {
+        TokenType type = get().type;
+
+        if (parentheses == 0 && (type == TokenType::CLOSE_PARAN || type == TokenType::COMMA ||
+            type == TokenType::EOL || type == TokenType::OPEN_CURL))
+            break;
+
+        if (type == TokenType::OPEN_PARAN)
+            ++parentheses;
+        else if (type == TokenType::CLOSE_PARAN)
+            --parentheses;
+
+        move_next();
+    }
+
+    return result;
+}
+
 #pragma endregion
 
+/**
+ * Prints where the resolver placed a variable.
+*/
+void Parser::print_slot(const SI_Variable& siVariable, std::string padding)
+{
+    if (siVariable.slot < 0)
+        std::cout << padding << "Slot: by name" << std::endl;
+    else
+        std::cout << padding << "Slot: " << siVariable.slot << (siVariable.declaration ? " (declaration)" : "") << std::endl;
+}
+
+/**
+ * Prints the operand types a typed operator was proven to have.
+*/
+void Parser::print_specialization(const Statement& statement, std::string padding)
+{
+    if (statement.specialization == Specialization::TYPED_INT32)
+        std::cout << padding << "Typed: int" << std::endl;
+    else if (statement.specialization == Specialization::TYPED_FLOAT32)
+        std::cout << padding << "Typed: float" << std::endl;
+    else if (statement.specialization == Specialization::TYPED_STRING)
+        std::cout << padding << "Typed: string" << std::endl;
+}
+
+/**
+ * Prints a chain of operators the same way print_statement
+ * would, one operator in a loop at a time.
+*/
+void Parser::print_operators(const Statement& chain, std::string padding)
+{
+    std::vector<const Statement*> operators;
+    const Statement& first = collect_operator_chain(chain, operators);
+
+    for (const Statement* op : operators)
+    {
+        std::cout << padding << statement_type_as_str(op->type) << std::endl;
+        print_specialization(*op, padding);
+        padding += '\t';
+    }
+
+    print_statement(first, padding);
+
+    for (auto op = operators.rbegin(); op != operators.rend(); ++op)
+    {
+        print_statement((*op)->children()[1], padding);
+        padding.pop_back();
+    }
+}
+
 /**
  * Prints a statement and its statements recursively.
 */
 void Parser::print_statement(const Statement& statement, std::string padding)
 {
+    if (is_binary_operator(statement.type))
+    {
+        print_operators(statement, padding);
+        return;
+    }
+
     std::string typeName = statement_type_as_str(statement.type);
 
     std::cout << padding << typeName << std::endl;
@@ -575,59 +877,75 @@ void Parser::print_statement(const Statement& statement, std::string padding)
     switch (statement.type)
     {
     case StatementType::ASSIGN:
-        if (SI_String* siAssign = static_cast<SI_String*>(statement.info.get()))
+        if (SI_Variable* siAssign = static_cast<SI_Variable*>(statement.info))
         {
-            std::cout << padding << "Variable Name: " << siAssign->value << std::endl;
+            std::cout << padding << "Variable Name: " << SymbolTable::global().get_name(siAssign->symbol) << std::endl;
+            print_slot(*siAssign, padding);
 
-            for (auto& child : statement.children)
+            for (auto& child : statement.children())
                 print_statement(child, padding + "\t");
         }
         break;
     case StatementType::NUMBER:
-        if (SI_String* siNumber = static_cast<SI_String*>(statement.info.get()))
+        if (SI_String* siNumber = static_cast<SI_String*>(statement.info))
         {
             std::cout << padding << "Value: " << siNumber->value << std::endl;
         }
         break;
     case StatementType::CHAR:
-        if (SI_String* siChar = static_cast<SI_String*>(statement.info.get()))
+        if (SI_String* siChar = static_cast<SI_String*>(statement.info))
         {
             std::cout << padding << "Value: " << siChar->value << std::endl;
         }
         break;
     case StatementType::VARIABLE:
-        if (SI_String* siVariable = static_cast<SI_String*>(statement.info.get()))
+        if (SI_Variable* siVariable = static_cast<SI_Variable*>(statement.info))
         {
-            std::cout << padding << "Value: " << siVariable->value << std::endl;
+            std::cout << padding << "Value: " << SymbolTable::global().get_name(siVariable->symbol) << std::endl;
+            print_slot(*siVariable, padding);
         }
         break;
     case StatementType::BOOLEAN:
-        if (SI_Boolean* siBoolean = static_cast<SI_Boolean*>(statement.info.get()))
+        if (SI_Boolean* siBoolean = static_cast<SI_Boolean*>(statement.info))
         {
             std::cout << padding << "Value: " << (siBoolean->value ? "true" : "false") << std::endl;
         }
         break;
+    case StatementType::CONSTANT:
+        if (SI_Constant* siConstant = static_cast<SI_Constant*>(statement.info))
+        {
+            Object value = siConstant->value;
+            std::cout << padding << "Value: " << value.to_string().as_string() << std::endl;
+        }
+        break;
     case StatementType::BLOCK:
-        for (auto& child : statement.children)
+        for (auto& child : statement.children())
             print_statement(child, padding + "\t");
         break;
     case StatementType::FUNCTION:
-        if (SI_Function* siFunction = static_cast<SI_Function*>(statement.info.get()))
+        if (SI_Function* siFunction = static_cast<SI_Function*>(statement.info))
         {
-            std::cout << padding << "Function Name: " << siFunction->functionName << std::endl;
+            std::cout << padding << "Function Name: " << SymbolTable::global().get_name(siFunction->functionName) << std::endl;
             std::cout << padding << "[" << std::endl;
             for (auto& paramName : siFunction->parameterNames)
-                std::cout << padding << "\tParameter Name: " << paramName << "," << std::endl;
+                std::cout << padding << "\tParameter Name: " << SymbolTable::global().get_name(paramName) << "," << std::endl;
             std::cout << padding << "]" << std::endl;
-            print_statement(statement.children[0], padding + '\t');
+            print_statement(statement.children()[0], padding + '\t');
+        }
+        break;
+    case StatementType::INLINE:
+        if (SI_Symbol* siInline = static_cast<SI_Symbol*>(statement.info))
+        {
+            std::cout << padding << "Function Name: " << SymbolTable::global().get_name(siInline->symbol) << std::endl;
+            print_statement(statement.children()[0], padding + '\t');
         }
         break;
     case StatementType::FUNCTION_CALL:
-        if (SI_String* siFunctionCall = static_cast<SI_String*>(statement.info.get()))
+        if (SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(statement.info))
         {
-            std::cout << padding << "Function Name: " << siFunctionCall->value << std::endl;
+            std::cout << padding << "Function Name: " << SymbolTable::global().get_name(siFunctionCall->symbol) << (siFunctionCall->native >= 0 ? " (native)" : "") << std::endl;
             std::cout << padding << "[" << std::endl;
-            for (auto& stmt : statement.children)
+            for (auto& stmt : statement.children())
             {
                 print_statement(stmt, padding + '\t');
                 std::cout << padding << "\t," << std::endl;
@@ -636,7 +954,9 @@ void Parser::print_statement(const Statement& statement, std::string padding)
         }
         break;
     default:
-        for (auto& child : statement.children)
+        print_specialization(statement, padding);
+
+        for (auto& child : statement.children())
             print_statement(child, padding + "\t");
         break;
     }
@@ -649,31 +969,54 @@ void Parser::print_statement(const Statement& statement, std::string padding)
 Parser::Parser() 
 {
     tokens = nullptr;
+    root = nullptr;
+    loopDepth = 0;
+    functionDepth = 0;
+    termDepth = 0;
+    tooDeep = false;
 }
 
 Statement* Parser::get_root()
 {
-    return &root;
+    return root;
+}
+
+Ast* Parser::get_ast()
+{
+    return &ast;
+}
+
+void Parser::set_root(Statement* root)
+{
+    this->root = root;
 }
 
 void Parser::parse_statements(std::vector<Token>* tokens, Diagnostics* diagnostics)
 {
     this->tokens = tokens;
     this->diagnostics = diagnostics;
-    root.type = StatementType::BLOCK;
+    ast.clear();
+    pending.clear();
+    termDepth = 0;
+
+    Statement block(StatementType::BLOCK, 0, 0);
+    block.info = ast.make_info<SI_Block>();
     
     for (index = 0; index < tokens->size(); ++index)
     {
         Statement statement = parse_next_statement();
 
         if (statement.type != StatementType::ERROR)
-            root.children.push_back(statement);
+            pending.push_back(statement);
     }
+
+    ast.add_children(block, pending, 0);
+    root = ast.add_root(block);
 }
 
 void Parser::print_ast()
 {
-    print_statement(root, "");
+    print_statement(*root, "");
 }
 
 #pragma endregion
\ No newline at end of file
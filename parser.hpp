@@ -44,6 +44,9 @@ namespace pop
         RETURN,
         BREAK,
         CONTINUE,
+        CONSTANT,
+        INVARIANT,
+        INLINE,
     };
 
     /**
@@ -111,19 +114,68 @@ namespace pop
             return "BREAK";
         case StatementType::CONTINUE:
             return "CONTINUE";
+        case StatementType::CONSTANT:
+            return "CONSTANT";
+        case StatementType::INVARIANT:
+            return "INVARIANT";
+        case StatementType::INLINE:
+            return "INLINE";
         }
 
         return "NOT A TYPE";
     }
 
+    /**
+     * The operand types an operator statement has specialized itself for.
+     * An operator starts out unspecialized, specializes on the types it
+     * sees the first time it runs and turns generic once they change.
+     * Typed operators had their operand types proven before the script
+     * ran and never check them.
+    */
+    enum class Specialization : char
+    {
+        NONE,
+        INT32,
+        FLOAT32,
+        STRING,
+        GENERIC,
+        TYPED_INT32,
+        TYPED_FLOAT32,
+        TYPED_STRING
+    };
+
     #pragma region Data Structures for Statements
 
-    struct StatementInfo { };
+    struct Statement;
 
+    /**
+     * The extra data of a statement. Infos are owned by the
+     * Ast the statement lives in.
+    */
+    struct StatementInfo
+    {
+        virtual ~StatementInfo() { }
+    };
+
+    /**
+     * A function definition. The runner counts how often it calls
+     * the function and remembers the chunk it runs it through
+     * once the function is hot. The resolver marks functions whose
+     * result only depends on their arguments as pure, and the pure
+     * ones that do enough work to be worth remembering as memoized.
+     * The memo cache counts how often their calls are looked up
+     * and found.
+    */
     struct SI_Function : public StatementInfo
     {
-        std::string functionName;
-        std::vector<std::string> parameterNames;
+        Symbol functionName;
+        std::vector<Symbol> parameterNames;
+        unsigned int calls = 0;
+        int entry = -1;
+        bool pure = false;
+        bool memoized = false;
+        unsigned int memoLookups = 0;
+        unsigned int memoHits = 0;
     };
 
     struct SI_String : public StatementInfo
@@ -136,38 +188,226 @@ namespace pop
         bool value;
     };
 
+    /**
+     * A name, interned by the tokenizer.
+    */
+    struct SI_Symbol : public StatementInfo
+    {
+        Symbol symbol;
+    };
+
+    /**
+     * A function call. The resolver binds calls to native
+     * functions to the index of the native. Calls to user
+     * functions remember the function they found last and
+     * the function epoch of the stack they found it in.
+     * The resolver marks returned calls that can run in
+     * place of the function returning them.
+    */
+    struct SI_FunctionCall : public SI_Symbol
+    {
+        int native = -1;
+        bool tail = false;
+        Statement* callee = nullptr;
+        unsigned int calleeEpoch = 0;
+    };
+
+    /**
+     * A variable read or assignment. The resolver fills in the slot of
+     * the variable, counted from the base of the function's frame.
+     * Variables the resolver could not find keep a slot of -1 and are
+     * looked up by name.
+     *
+     * An assignment by name sets the variable of a caller that has the
+     * name, and only declares it in its slot if no caller has one.
+    */
+    struct SI_Variable : public SI_Symbol
+    {
+        int slot = -1;
+        bool declaration = false;
+        bool byName = false;
+    };
+
+    /**
+     * The variables declared directly in a block, in slot order,
+     * starting at the frame slot offset, and the functions it defines.
+     * A block that declares neither has no scope of its own and runs
+     * in the scope around it.
+    */
+    struct SI_Block : public StatementInfo
+    {
+        unsigned int offset = 0;
+        std::vector<Symbol> localNames;
+        std::vector<Statement*> functions;
+        bool scoped = true;
+    };
+
+    /**
+     * A loop with invariant expressions. Every time the loop starts it
+     * gets a new stamp, and the invariants computed under that stamp
+     * can be reused until the loop ends. The walker and the virtual
+     * machine take their stamps from the same counter.
+    */
+    struct SI_Loop : public StatementInfo
+    {
+        static unsigned int lastStamp;
+
+        unsigned int stamp = 0;
+    };
+
     #pragma endregion
 
+    /**
+     * The statements directly below a statement.
+     * They are stored next to each other in the Ast.
+    */
+    template <typename T>
+    struct ChildList
+    {
+        T* first;
+        unsigned int count;
+
+        T& operator[](unsigned int index) const { return first[index]; }
+        T* begin() const { return first; }
+        T* end() const { return first + count; }
+        unsigned int size() const { return count; }
+        bool empty() const { return count == 0; }
+    };
+
+    /**
+     * A fixed size node of the syntax tree. Statements live in an Ast
+     * and find their children through a 32 bit offset from themselves.
+     * The line of a statement is looked up in the File by its number.
+     * Operators rewrite their specialization while the script runs.
+    */
     struct Statement
     {
-        std::shared_ptr<StatementInfo> info;
-        StatementType type;
-        std::vector<Statement> children;
-        std::string line;
+        StatementInfo* info;
+        int firstChild;
+        unsigned int childCount;
         unsigned int lineColumn;
         unsigned int lineNumber;
+        StatementType type;
+        mutable Specialization specialization;
 
         Statement();
-        Statement(StatementType type, std::string line, unsigned int lineColumn, unsigned int lineNumber);
+        Statement(StatementType type, unsigned int lineColumn, unsigned int lineNumber);
+
+        ChildList<Statement> children() { return { this + firstChild, childCount }; }
+        ChildList<const Statement> children() const { return { this + firstChild, childCount }; }
+    };
+
+    /**
+     * If the statement is a binary operator. The parser chains operators
+     * through their first operand, so a + a + a is ((a + a) + a).
+    */
+    static bool is_binary_operator(StatementType type)
+    {
+        switch (type)
+        {
+        case StatementType::ADD_OP:
+        case StatementType::SUB_OP:
+        case StatementType::MULT_OP:
+        case StatementType::DIV_OP:
+        case StatementType::MOD_OP:
+        case StatementType::EQUALS_OP:
+        case StatementType::NEQUALS_OP:
+        case StatementType::GTHANE_OP:
+        case StatementType::LTHANE_OP:
+        case StatementType::GTHAN_OP:
+        case StatementType::LTHAN_OP:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * Walks down the first operands of a chain of binary operators,
+     * pushing every operator on the way, outermost first, and returns
+     * the first operand that is not an operator. Passes go over a chain
+     * through this in a loop, from the first operand back up through the
+     * second operand of every operator, so however long the chain is it
+     * takes no more C++ stack than a single operator.
+    */
+    template <typename T>
+    T& collect_operator_chain(T& statement, std::vector<T*>& chain)
+    {
+        T* operand = &statement;
+
+        while (is_binary_operator(operand->type))
+        {
+            chain.push_back(operand);
+            operand = &operand->children()[0];
+        }
+
+        return *operand;
+    }
+
+    /**
+     * Owns every statement and statement info of a script.
+     *
+     * A statement is built as a value and given its children once they
+     * are all parsed. The children are then copied next to each other at
+     * the end of the arena, so every statement is copied exactly once.
+     * Statements never move after that, but the arena must not grow once
+     * pointers to its statements are handed out.
+    */
+    class Ast
+    {
+        std::vector<Statement> statements;
+        std::vector<std::unique_ptr<StatementInfo>> infos;
+
+        unsigned int append(const Statement& statement);
+
+    public:
+        template <typename T>
+        T* make_info()
+        {
+            infos.push_back(std::make_unique<T>());
+            return static_cast<T*>(infos.back().get());
+        }
+
+        void add_children(Statement& parent, std::vector<Statement>& pending, unsigned int mark);
+        Statement* add_root(const Statement& root);
+        Statement detach(unsigned int index) const;
+        Statement& get(unsigned int index) { return statements[index]; }
+        unsigned int index_of(const Statement& statement) const { return &statement - statements.data(); }
+        void clear();
+        unsigned int get_size() const;
     };
 
     /**
      * The parser takes a list of tokens and turns 
      * them into statements.
+     *
+     * Every pass over the tree walks the left operands of a chain of
+     * operators in a loop but recurses through everything else, so an
+     * expression nested deeper than MAX_EXPRESSION_DEPTH, through
+     * parentheses, calls, minus signs or right operands, is an error.
+     * Chains like a + a + ... can be as long as they like.
     */
     class Parser
     {
+        static const unsigned int MAX_EXPRESSION_DEPTH = 1000;
+
         std::vector<Token>* tokens;
         Diagnostics* diagnostics;
-        Statement root;
+        Ast ast;
+        Statement* root;
+        std::vector<Statement> pending; // children waiting for their parent
         unsigned int index;
+        unsigned int loopDepth;
+        unsigned int functionDepth;
+        unsigned int termDepth;         // terms and right operands being parsed inside each other
+        bool tooDeep;                   // the outermost expression was reported
 
         bool eof() const;
         void move_next();
         void move_back();
-        Token get();
-        Token prev();
-        Token next();
+        const Token& get() const;
+        const Token& prev() const;
+        const Token& next() const;
 
         Statement parse_next_statement();
         Statement parse_function();
@@ -182,13 +422,19 @@ namespace pop
         Statement parse_add_sub();
         Statement parse_mult_div_mod();
         Statement parse_term();
+        Statement skip_deep_expression();
 
+        void print_slot(const SI_Variable& siVariable, std::string padding);
+        void print_specialization(const Statement& statement, std::string padding);
+        void print_operators(const Statement& chain, std::string padding);
         void print_statement(const Statement& statement, std::string padding);
 
     public:
         Parser();
         
         Statement* get_root();
+        Ast* get_ast();
+        void set_root(Statement* root);
         void parse_statements(std::vector<Token>* tokens, Diagnostics* diagnostics);
         void print_ast();
     };
@@ -0,0 +1,466 @@
+#include "resolver.hpp"
+
+using namespace pop;
+
+#pragma region Private Methods
+
+/**
+ * Finds a declared variable in the scopes of the current function.
+*/
+bool Resolver::lookup(Symbol name, int& slot)
+{
+    for (int i = scopes.size() - 1; i >= 0; --i)
+    {
+        for (unsigned int j = 0; j < scopes[i].size(); ++j)
+        {
+            if (scopes[i][j] == name)
+            {
+                slot = offsets[i] + j;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * The frame slot the next declared variable gets.
+*/
+unsigned int Resolver::next_slot() const
+{
+    if (scopes.empty())
+        return 0;
+
+    return offsets.back() + scopes.back().size();
+}
+
+/**
+ * If an assignment to a name the running function has not declared
+ * could find the variable in a frame below.
+*/
+bool Resolver::is_set_by_name(Symbol name) const
+{
+    if (functionScopes.empty())
+        return false;
+
+    auto below = namesBelow.find(functionScopes.back().function->functionName);
+    return below != namesBelow.end() && below->second.count(name) > 0;
+}
+
+/**
+ * Finds the names every function declares and the functions it calls.
+ * Names declared outside of any function belong to the root.
+*/
+void Resolver::collect_names(const Statement& statement, int function)
+{
+    switch (statement.type)
+    {
+    case StatementType::FUNCTION:
+        {
+            SI_Function* siFunction = static_cast<SI_Function*>(statement.info);
+            function = functionNames.size();
+
+            functionNames.emplace_back();
+            functionNames.back().name = siFunction->functionName;
+            functionNames.back().declared.insert(siFunction->parameterNames.begin(), siFunction->parameterNames.end());
+        }
+        break;
+    case StatementType::ASSIGN:
+        {
+            Symbol name = static_cast<SI_Variable*>(statement.info)->symbol;
+
+            if (function < 0)
+                rootNames.insert(name);
+            else
+                functionNames[function].declared.insert(name);
+        }
+        break;
+    case StatementType::FUNCTION_CALL:
+        {
+            Symbol name = static_cast<SI_FunctionCall*>(statement.info)->symbol;
+
+            if (function >= 0 && NativeTable::global().find_native(name) < 0)
+                functionNames[function].called.insert(name);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (is_binary_operator(statement.type))
+    {
+        std::vector<const Statement*> chain;
+        collect_names(collect_operator_chain(statement, chain), function);
+
+        for (auto op = chain.rbegin(); op != chain.rend(); ++op)
+            collect_names((*op)->children()[1], function);
+
+        return;
+    }
+
+    for (auto& child : statement.children())
+        collect_names(child, function);
+}
+
+/**
+ * Works out which names can be in a frame below a function: the names
+ * of the root and of every function that calls it, however indirectly.
+*/
+void Resolver::find_names_below()
+{
+    // the functions of every name
+    std::unordered_map<Symbol, std::vector<unsigned int>> byName;
+
+    for (unsigned int i = 0; i < functionNames.size(); ++i)
+        byName[functionNames[i].name].push_back(i);
+
+    for (auto& caller : functionNames)
+    {
+        std::unordered_set<Symbol> reached;
+        std::vector<Symbol> work(caller.called.begin(), caller.called.end());
+
+        while (!work.empty())
+        {
+            Symbol name = work.back();
+            work.pop_back();
+
+            if (!reached.insert(name).second)
+                continue;
+
+            auto callees = byName.find(name);
+
+            if (callees == byName.end())
+                continue;
+
+            for (auto callee : callees->second)
+                work.insert(work.end(), functionNames[callee].called.begin(), functionNames[callee].called.end());
+        }
+
+        for (auto& name : reached)
+            namesBelow[name].insert(caller.declared.begin(), caller.declared.end());
+    }
+
+    for (auto& function : functionNames)
+        namesBelow[function.name].insert(rootNames.begin(), rootNames.end());
+}
+
+/**
+ * Resolves a function body on its own, parameters are its outermost scope.
+*/
+void Resolver::resolve_function(Statement& function)
+{
+    SI_Function* siFunction = static_cast<SI_Function*>(function.info);
+
+    std::vector<std::vector<Symbol>> enclosingScopes;
+    std::vector<unsigned int> enclosingOffsets;
+    enclosingScopes.swap(scopes);
+    enclosingOffsets.swap(offsets);
+
+    if (!functionScopes.empty())
+        functionScopes.back().definesFunctions = true;
+
+    functionScopes.emplace_back();
+    functionScopes.back().function = siFunction;
+    functionScopes.back().names = siFunction->parameterNames;
+    functionScopes.back().enclosingBlocks = blocks;
+
+    // the arguments are the first slots of the frame
+    scopes.push_back(siFunction->parameterNames);
+    offsets.push_back(0);
+    resolve_block(function.children()[0]);
+
+    resolvedFunctions.push_back(std::move(functionScopes.back()));
+    functionScopes.pop_back();
+
+    scopes.swap(enclosingScopes);
+    offsets.swap(enclosingOffsets);
+}
+
+/**
+ * Resolves a block and records the variables and functions it declares.
+*/
+void Resolver::resolve_block(Statement& block)
+{
+    SI_Block* siBlock = static_cast<SI_Block*>(block.info);
+    siBlock->offset = next_slot();
+    siBlock->functions.clear();
+
+    scopes.emplace_back();
+    offsets.push_back(siBlock->offset);
+    blocks.push_back(&block);
+
+    for (auto& statement : block.children())
+    {
+        resolve_statement(statement);
+
+        if (statement.type == StatementType::FUNCTION)
+            siBlock->functions.push_back(&statement);
+    }
+
+    siBlock->localNames.swap(scopes.back());
+    siBlock->scoped = !siBlock->localNames.empty() || !siBlock->functions.empty();
+
+    scopes.pop_back();
+    offsets.pop_back();
+    blocks.pop_back();
+}
+
+void Resolver::resolve_statement(Statement& statement)
+{
+    switch (statement.type)
+    {
+    case StatementType::ASSIGN:
+        {
+            SI_Variable* siAssign = static_cast<SI_Variable*>(statement.info);
+
+            // the value is evaluated before the variable exists
+            resolve_expression(statement.children()[0]);
+
+            siAssign->declaration = !lookup(siAssign->symbol, siAssign->slot);
+            siAssign->byName = siAssign->declaration && is_set_by_name(siAssign->symbol);
+
+            if (siAssign->byName)
+            {
+                // the slot is only used if no caller has the variable,
+                // so the variable is always read and set by name
+                siAssign->slot = next_slot();
+                scopes.back().push_back(NO_SYMBOL);
+                namesSetByName.insert(siAssign->symbol);
+                functionScopes.back().names.push_back(siAssign->symbol);
+                functionScopes.back().setsByName = true;
+            }
+            else if (siAssign->declaration)
+            {
+                siAssign->slot = next_slot();
+                scopes.back().push_back(siAssign->symbol);
+
+                if (!functionScopes.empty())
+                    functionScopes.back().names.push_back(siAssign->symbol);
+            }
+        }
+        break;
+    case StatementType::IF:
+        resolve_expression(statement.children()[0]);
+        resolve_block(statement.children()[1]);
+
+        if (statement.children().size() == 3)
+            resolve_statement(statement.children()[2]);
+        break;
+    case StatementType::ELSE:
+        resolve_block(statement.children()[0]);
+        break;
+    case StatementType::WHILE:
+        if (!functionScopes.empty())
+            functionScopes.back().loops = true;
+
+        resolve_expression(statement.children()[0]);
+        resolve_block(statement.children()[1]);
+        break;
+    case StatementType::FUNCTION:
+        resolve_function(statement);
+        break;
+    case StatementType::RETURN:
+        {
+            resolve_expression(statement.children()[0]);
+
+            const Statement* value = &statement.children()[0];
+
+            while (value->type == StatementType::EXP)
+                value = &value->children()[0];
+
+            if (value->type == StatementType::FUNCTION_CALL && !functionScopes.empty())
+            {
+                SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(value->info);
+
+                if (siFunctionCall->native < 0)
+                    functionScopes.back().returnedCalls.push_back(siFunctionCall);
+            }
+        }
+        break;
+    default:
+        resolve_expression(statement);
+        break;
+    }
+}
+
+void Resolver::resolve_expression(Statement& expression)
+{
+    if (expression.type == StatementType::VARIABLE)
+    {
+        SI_Variable* siVariable = static_cast<SI_Variable*>(expression.info);
+        siVariable->slot = -1;
+
+        if (!lookup(siVariable->symbol, siVariable->slot))
+        {
+            namesReadByName.insert(siVariable->symbol);
+
+            if (!functionScopes.empty())
+                functionScopes.back().readsByName = true;
+        }
+
+        return;
+    }
+
+    if (expression.type == StatementType::FUNCTION_CALL)
+        resolve_function_call(expression);
+
+    if (is_binary_operator(expression.type))
+    {
+        std::vector<Statement*> chain;
+        resolve_expression(collect_operator_chain(expression, chain));
+
+        for (auto op = chain.rbegin(); op != chain.rend(); ++op)
+            resolve_expression((*op)->children()[1]);
+
+        return;
+    }
+
+    for (auto& child : expression.children())
+        resolve_expression(child);
+}
+
+/**
+ * Binds a call to a native function. Natives take
+ * precedence over user functions with the same name.
+*/
+void Resolver::resolve_function_call(Statement& functionCall)
+{
+    SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(functionCall.info);
+    siFunctionCall->tail = false;
+
+    int native = NativeTable::global().find_native(siFunctionCall->symbol);
+
+    if (native < 0)
+    {
+        if (!functionScopes.empty())
+            functionScopes.back().calledFunctions.push_back(siFunctionCall->symbol);
+
+        return;
+    }
+
+    if (!NativeTable::global().get_native(native).pure && !functionScopes.empty())
+        functionScopes.back().callsImpureNatives = true;
+
+    if (NativeTable::global().get_native(native).arity != functionCall.children().size())
+    {
+        diagnostics->add_error("Inccorect number of parameters!", functionCall.lineColumn, functionCall.lineNumber);
+        return;
+    }
+
+    siFunctionCall->native = native;
+}
+
+/**
+ * Marks the returned calls of every function whose frame nobody
+ * can see. Only known once every name read or set by name is.
+*/
+void Resolver::mark_tail_calls()
+{
+    for (auto& function : resolvedFunctions)
+    {
+        if (function.definesFunctions)
+            continue;
+
+        bool visible = false;
+
+        for (auto name : function.names)
+        {
+            if (namesReadByName.count(name) > 0 || namesSetByName.count(name) > 0)
+            {
+                visible = true;
+                break;
+            }
+        }
+
+        if (visible)
+            continue;
+
+        for (auto call : function.returnedCalls)
+            call->tail = true;
+    }
+}
+
+/**
+ * Marks the functions that are pure. Every function that could be
+ * pure starts out pure, then functions calling one that is not stop
+ * being pure until nothing changes. So functions calling each other
+ * stay pure as long as none of them does anything else.
+*/
+void Resolver::mark_pure_functions()
+{
+    // where the functions of every name are defined
+    std::unordered_map<Symbol, std::vector<unsigned int>> definitions;
+
+    for (unsigned int i = 0; i < resolvedFunctions.size(); ++i)
+    {
+        FunctionScope& function = resolvedFunctions[i];
+        function.function->pure = !function.definesFunctions && !function.readsByName && !function.setsByName && !function.callsImpureNatives;
+        definitions[function.function->functionName].push_back(i);
+    }
+
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (auto& function : resolvedFunctions)
+        {
+            if (!function.function->pure)
+                continue;
+
+            for (auto name : function.calledFunctions)
+            {
+                auto definition = definitions.find(name);
+
+                if (definition == definitions.end() || definition->second.size() != 1)
+                {
+                    function.function->pure = false;
+                    break;
+                }
+
+                const FunctionScope& callee = resolvedFunctions[definition->second[0]];
+                const std::vector<const Statement*>& around = function.enclosingBlocks;
+
+                if (!callee.function->pure || std::find(around.begin(), around.end(), callee.enclosingBlocks.back()) == around.end())
+                {
+                    function.function->pure = false;
+                    break;
+                }
+            }
+
+            changed = changed || !function.function->pure;
+        }
+    }
+
+    for (auto& function : resolvedFunctions)
+        function.function->memoized = function.function->pure && (function.loops || !function.calledFunctions.empty());
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+void Resolver::resolve(Statement* root, Diagnostics* diagnostics)
+{
+    this->diagnostics = diagnostics;
+    scopes.clear();
+    offsets.clear();
+    blocks.clear();
+    functionScopes.clear();
+    resolvedFunctions.clear();
+    namesReadByName.clear();
+    namesSetByName.clear();
+    functionNames.clear();
+    rootNames.clear();
+    namesBelow.clear();
+
+    collect_names(*root, -1);
+    find_names_below();
+    resolve_block(*root);
+    mark_tail_calls();
+    mark_pure_functions();
+}
+
+#pragma endregion
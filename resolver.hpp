@@ -0,0 +1,108 @@
+#ifndef RESOLVER
+#define RESOLVER
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+
+#include "parser.hpp"
+#include "natives.hpp"
+
+namespace pop
+{
+    /**
+     * Walks the statements after parsing and gives every variable
+     * a slot in the frame of its function so it can be found without
+     * a name search. A nested block starts after the variables its
+     * enclosing blocks have declared so far, so blocks that are never
+     * active at the same time share slots.
+     *
+     * Functions see the variables of their caller, so names a function
+     * does not declare itself are left to be looked up by name. An
+     * assignment in a function to a name it has not declared sets the
+     * variable of a caller that has it. That only happens by name for
+     * the names that can be in a frame below the function: the ones
+     * declared outside of any function and by the functions that can
+     * end up calling it. Other variables are simply declared.
+     * Calls to native functions are bound here and their arity checked.
+     * A tree rebuilt by the optimizer is simply resolved again.
+     *
+     * A returned call is a tail call when the returning function's frame
+     * can go before the call runs: none of its variables is ever read
+     * or set by name and it defines no functions the callee could need.
+     *
+     * A function is pure when its result only depends on its arguments:
+     * it reads or sets no variable by name, calls no impure native,
+     * defines no functions and only calls pure functions. A called
+     * function must be the only one with its name and defined around the
+     * caller, so the call always finds it. Pure functions that call
+     * functions or loop are memoized, anything less is cheaper to run
+     * again.
+    */
+    class Resolver
+    {
+        /**
+         * What a function declares and calls, for finding
+         * its tail calls and whether it is pure.
+        */
+        struct FunctionScope
+        {
+            SI_Function* function = nullptr;
+            std::vector<Symbol> names;
+            std::vector<SI_FunctionCall*> returnedCalls;
+            std::vector<Symbol> calledFunctions;
+            std::vector<const Statement*> enclosingBlocks;
+            bool definesFunctions = false;
+            bool loops = false;
+            bool readsByName = false;
+            bool setsByName = false;
+            bool callsImpureNatives = false;
+        };
+
+        /**
+         * The names a function declares and the functions it calls.
+        */
+        struct FunctionNames
+        {
+            Symbol name;
+            std::unordered_set<Symbol> declared;
+            std::unordered_set<Symbol> called;
+        };
+
+        Diagnostics* diagnostics;
+        std::vector<std::vector<Symbol>> scopes;
+        std::vector<unsigned int> offsets;
+        std::vector<const Statement*> blocks;
+        std::vector<FunctionScope> functionScopes;
+        std::vector<FunctionScope> resolvedFunctions;
+        std::unordered_set<Symbol> namesReadByName;
+        std::unordered_set<Symbol> namesSetByName;
+        std::vector<FunctionNames> functionNames;
+        std::unordered_set<Symbol> rootNames;
+        // by function name, the names that can be in a frame below it
+        std::unordered_map<Symbol, std::unordered_set<Symbol>> namesBelow;
+
+        bool lookup(Symbol name, int& slot);
+        unsigned int next_slot() const;
+        bool is_set_by_name(Symbol name) const;
+
+        void collect_names(const Statement& statement, int function);
+        void find_names_below();
+
+        void resolve_function(Statement& function);
+        void resolve_block(Statement& block);
+        void resolve_statement(Statement& statement);
+        void resolve_expression(Statement& expression);
+        void resolve_function_call(Statement& functionCall);
+        void mark_tail_calls();
+        void mark_pure_functions();
+
+    public:
+        void resolve(Statement* root, Diagnostics* diagnostics);
+    };
+}
+
+#endif
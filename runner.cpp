@@ -1,591 +1,1150 @@
 #include "runner.hpp"
+#include "vm.hpp"
 
 using namespace pop;
 
-#pragma region Scope
+#pragma region Stack
 
-Scope::Scope()
+// shared by every stack so two stacks never hand out the same epoch
+unsigned int Stack::lastFunctionEpoch = 0;
+
+Stack::Stack()
 {
-    returnFlag = false;
-    breakFlag = false;
-    continueFlag = false;
+    base = 0;
+    top = 0;
+    functionEpoch = 0;
 }
 
 /**
- * Checks to see if a variable exists on the current or subsequent parent stacks.
+ * Makes room for at least one more slot above the top.
 */
-bool Scope::has_variable(const std::string& variableName)
-{   
-    for (auto& sa : stack)
-    {
-        if (sa.variableName == variableName)
-        {
-            return true;
-        }
-    }
-
-    if (parent == nullptr) return false;
-    return parent->has_variable(variableName);
+void Stack::grow()
+{
+    slots.resize(slots.empty() ? 64 : slots.size() * 2, StackAllocation { NO_SYMBOL, Object() });
 }
 
 /**
- * Gets the variable from the current or subsequent parent stacks.
+ * Forgets every slot from the top down to the new top.
 */
-Object Scope::get_variable(const std::string& variableName)
+void Stack::clear_to(unsigned int newTop)
 {
-    for (auto& sa : stack)
+    while (top > newTop)
     {
-        if (sa.variableName == variableName)
-            return sa.value;
+        --top;
+        slots[top].variableName = NO_SYMBOL;
+        slots[top].value = Object();
     }
+}
 
-    if (parent != nullptr)
+/**
+ * Gets a variable by name, searching from the top of the stack down
+ * through the running blocks and the frames of every caller.
+ * Only used for variables the resolver could not place.
+*/
+Object Stack::get_variable(Symbol variableName)
+{
+    for (unsigned int i = top; i-- > 0;)
     {
-        return parent->get_variable(variableName);
-    } 
+        if (slots[i].variableName == variableName)
+            return slots[i].value;
+    }
 
-    Object nil;
-    nil.type == ObjectType::NIL;
-    return nil;
+    return Object();
 }
 
 /**
- * Sets the variable on the current or subsequent parent stacks.
+ * Sets a variable by name in the running blocks or the frames of
+ * every caller. Returns false if no variable has the name.
 */
-void Scope::set_variable(const std::string& variableName, Object value)
+bool Stack::set_variable(Symbol variableName, const Object& value)
 {
-    if (has_variable(variableName))
+    for (unsigned int i = top; i-- > 0;)
     {
-        for (auto& sa : stack)
+        if (slots[i].variableName == variableName)
         {
-            if (sa.variableName == variableName)
-            {
-                sa.value = value;
-                return;
-            }
+            slots[i].value = value;
+            return true;
         }
-
-        parent->set_variable(variableName, value);
-    }
-    else
-    {
-        StackAllocation sa;
-        sa.variableName = variableName;
-        sa.value = value;
-        stack.push_back(sa);
     }
+
+    return false;
+}
+
+/**
+ * Declares a variable in its frame slot. Blocks declare their
+ * variables in slot order so the slot is always the top of the stack.
+*/
+void Stack::declare_variable(unsigned int slot, Symbol variableName, Object value)
+{
+    unsigned int index = base + slot;
+
+    while (index >= slots.size())
+        grow();
+
+    slots[index].variableName = variableName;
+    slots[index].value = value;
+
+    if (index >= top)
+        top = index + 1;
 }
 
 /**
- * Sets the parent scope.
+ * Pushes an argument for a call that has not started yet.
+ * It has no name until the callee's frame is entered.
 */
-void Scope::set_parent(Scope* parent)
+void Stack::push_argument(Object value)
 {
-    if (this == parent)
-        throw std::runtime_error("Trying to set a scopes parent to itself!");
+    if (top >= slots.size())
+        grow();
 
-    this->parent = parent;
+    slots[top].variableName = NO_SYMBOL;
+    slots[top].value = value;
+    ++top;
 }
 
 /**
- * Finds all of the functions within a given block and saves them.
+ * Starts running a block and makes its functions callable.
 */
-void Scope::create_function_table(Statement& block)
+void Stack::enter_block(Statement& block)
 {
-    for (auto& stmt : block.children)
-    {
-        if (stmt.type == StatementType::FUNCTION)
-        {
-            functions.push_back(&stmt);
-        }
-    }
+    const std::vector<Statement*>& blockFunctions = static_cast<SI_Block*>(block.info)->functions;
+
+    BlockMark mark;
+    mark.top = top;
+    mark.functionCount = functions.size();
+    mark.functionEpoch = functionEpoch;
+    blocks.push_back(mark);
+
+    if (blockFunctions.empty())
+        return;
+
+    // pushed backwards so the first of two functions with the same name wins
+    for (auto function = blockFunctions.rbegin(); function != blockFunctions.rend(); ++function)
+        functions.push_back(*function);
+
+    functionEpoch = ++lastFunctionEpoch;
+}
+
+/**
+ * Pops the variables and functions of the innermost block.
+*/
+void Stack::exit_block()
+{
+    const BlockMark& mark = blocks.back();
+    clear_to(mark.top);
+    functions.resize(mark.functionCount);
+    functionEpoch = mark.functionEpoch;
+    blocks.pop_back();
+}
+
+/**
+ * Starts a frame at the arguments pushed from frame base on
+ * and names them. Returns the base of the caller's frame.
+*/
+unsigned int Stack::enter_frame(unsigned int frameBase, const std::vector<Symbol>& parameterNames)
+{
+    for (unsigned int i = 0; i < parameterNames.size(); ++i)
+        slots[frameBase + i].variableName = parameterNames[i];
+
+    unsigned int callerBase = base;
+    base = frameBase;
+    return callerBase;
+}
+
+/**
+ * Pops the current frame and goes back to the caller's.
+*/
+void Stack::exit_frame(unsigned int callerBase)
+{
+    clear_to(base);
+    base = callerBase;
+}
+
+/**
+ * Drops everything above the new top, used when
+ * a call fails while its arguments are evaluated.
+*/
+void Stack::unwind(unsigned int newTop)
+{
+    clear_to(newTop);
 }
 
 /**
- * Retrieves a function from the given scope.
+ * Empties the stack.
 */
-Statement* Scope::get_function_in_block(std::string functionName)
+void Stack::reset()
 {
-    for (auto& function : functions)
+    clear_to(0);
+    functions.clear();
+    blocks.clear();
+    base = 0;
+    functionEpoch = 0;
+}
+
+/**
+ * Retrieves a function from the innermost block that defines it,
+ * searching through the blocks of every caller as well.
+*/
+Statement* Stack::get_function_in_block(Symbol functionName)
+{
+    for (unsigned int i = functions.size(); i-- > 0;)
     {
-        if (SI_String* siFunction = static_cast<SI_String*>(function->info.get()))
-        {
-            if (siFunction->value == functionName)
-            {
-                return function;
-            }
-        }
+        if (static_cast<SI_Function*>(functions[i]->info)->functionName == functionName)
+            return functions[i];
     }
 
-    if (parent != nullptr)
-        return parent->get_function_in_block(functionName);
-
     return nullptr;
 }
 
+#pragma endregion
+
+#pragma region Operators
+
+static Object make_value(int value) { return Object::make_int32(value); }
+static Object make_value(float value) { return Object::make_float32(value); }
+static Object make_value(std::string value) { return Object::make_string(std::move(value)); }
+
 /**
- * Gets this scopes stack.
+ * An operator with an int32, a float32 and a string variant for
+ * operands of the same type. Every other case goes through the
+ * kernel table of Object. Operators without a float32 or string
+ * variant say so.
 */
-std::vector<StackAllocation>& Scope::get_stack()
+#define ARITHMETIC_OPERATOR(name, binaryOp, symbol, floats, strings) \
+    struct name \
+    { \
+        static constexpr BinaryOp op = BinaryOp::binaryOp; \
+        static constexpr bool hasFloat32 = floats; \
+        static constexpr bool hasString = strings; \
+        template <typename T> \
+        static Object apply(const T& left, const T& right) { return make_value(left symbol right); } \
+    };
+
+#define COMPARISON_OPERATOR(name, binaryOp, symbol) \
+    struct name \
+    { \
+        static constexpr BinaryOp op = BinaryOp::binaryOp; \
+        static constexpr bool hasFloat32 = true; \
+        static constexpr bool hasString = true; \
+        template <typename T> \
+        static Object apply(const T& left, const T& right) { return Object::make_bool(left symbol right); } \
+    };
+
+ARITHMETIC_OPERATOR(AddOperator, ADD, +, true, true)
+ARITHMETIC_OPERATOR(SubOperator, SUB, -, true, false)
+ARITHMETIC_OPERATOR(MultOperator, MULT, *, true, false)
+ARITHMETIC_OPERATOR(DivOperator, DIV, /, true, false)
+ARITHMETIC_OPERATOR(ModOperator, MOD, %, false, false)
+COMPARISON_OPERATOR(EqualsOperator, EQUALS, ==)
+COMPARISON_OPERATOR(NequalsOperator, NEQUALS, !=)
+COMPARISON_OPERATOR(GthaneOperator, GTHANE, >=)
+COMPARISON_OPERATOR(LthaneOperator, LTHANE, <=)
+COMPARISON_OPERATOR(GthanOperator, GTHAN, >)
+COMPARISON_OPERATOR(LthanOperator, LTHAN, <)
+
+/**
+ * Picks the variant of an operator for the operand types it has seen.
+*/
+template <typename Operator>
+static Specialization specialize(const Object& left, const Object& right)
 {
-    return stack;
+    if (left.type != right.type)
+        return Specialization::GENERIC;
+
+    if (left.type == ObjectType::INT32)
+        return Specialization::INT32;
+
+    if (Operator::hasFloat32 && left.type == ObjectType::FLOAT32)
+        return Specialization::FLOAT32;
+
+    if (Operator::hasString && left.type == ObjectType::STRING)
+        return Specialization::STRING;
+
+    return Specialization::GENERIC;
 }
 
 #pragma endregion
 
 #pragma region Private Methods
 
+/**
+ * Adds an error at the location of a statement.
+*/
+void Runner::report(const std::string& message, const Statement& statement)
+{
+    diagnostics->add_error(message, statement.lineColumn, statement.lineNumber);
+    hasErrors = true;
+}
+
+/**
+ * Reports the pending error at the statement it escaped from.
+*/
+void Runner::report_pending(const Statement& statement)
+{
+    report(pendingError, statement);
+    errorPending = false;
+}
+
+/**
+ * Leaves an error pending for the enclosing statement to report.
+ * The expression evaluates to nil and every expression above
+ * it returns as soon as it sees the pending error.
+*/
+Object Runner::fail(const std::string& message)
+{
+    pendingError = message;
+    errorPending = true;
+    return Object();
+}
+
 /**
  * Runs a single block of statements.
 */
-void Runner::run_block(Statement& root, Scope* parentScope, Object* result)
+void Runner::run_block(Statement& root, Object* result)
 {
     if (root.type != StatementType::BLOCK)
         throw std::runtime_error("Trying to run a statement that is not a block as a block.");
 
-    Scope currentScope;
-    currentScope.set_parent(parentScope);
-    currentScope.create_function_table(root);
+    bool scoped = static_cast<SI_Block*>(root.info)->scoped;
 
-    for (auto& statement : root.children)
-    {
-        run_statement(statement, currentScope, result);
+    if (scoped)
+        stack.enter_block(root);
 
-        if (currentScope.returnFlag)
-        {
-            parentScope->returnFlag = currentScope.returnFlag;
-            break;
-        }
+    for (auto& statement : root.children())
+    {
+        run_statement(statement, result);
 
-        if (currentScope.breakFlag)
-        {
-            parentScope->breakFlag = currentScope.breakFlag;
+        if (returnFlag || breakFlag || continueFlag)
             break;
-        }
-
-        if (currentScope.continueFlag)
-        {
-            parentScope->continueFlag = currentScope.continueFlag;
-            break;
-        }
 
         // if we are running through our statements
         // and one of our statements causes an error
         // stop running this block of statements
-        if (diagnostics->has_errors())
+        if (hasErrors)
             break;
     }
+
+    if (scoped)
+        stack.exit_block();
 }
 
 /**
  * Runs a single statement.
 */
-void Runner::run_statement(Statement& statement, Scope& scope, Object* result)
+void Runner::run_statement(Statement& statement, Object* result)
 {
     if (statement.type == StatementType::FUNCTION) return;
-    if (scope.returnFlag || scope.breakFlag || scope.continueFlag) return;
+    if (returnFlag || breakFlag || continueFlag) return;
 
     // ASSIGNMENT STATEMENT
     if (statement.type == StatementType::ASSIGN)
     {
-        if (SI_String* siAssign = static_cast<SI_String*>(statement.info.get()))
+        if (SI_Variable* siAssign = static_cast<SI_Variable*>(statement.info))
         {
-            try 
+            Object value = eval_expression(statement.children()[0]);
+
+            if (errorPending)
             {
-                scope.set_variable(siAssign->value, eval_expression(statement.children[0], scope));
+                report_pending(statement);
+                return;
             }
-            catch (const std::exception& exp)
+
+            if (siAssign->byName)
             {
-                diagnostics->add_error(exp.what(), statement.line, statement.lineColumn, statement.lineNumber);
-                return;
+                if (!stack.set_variable(siAssign->symbol, value))
+                    stack.declare_variable(siAssign->slot, siAssign->symbol, value);
             }
+            else if (siAssign->declaration)
+                stack.declare_variable(siAssign->slot, siAssign->symbol, value);
+            else
+                stack.local(siAssign->slot) = value;
         }
     }
     // IF STATEMENT
     else if (statement.type == StatementType::IF)
     {
-        Object condition = eval_expression(statement.children[0], scope);
-
-        Scope ifScope;
-        ifScope.set_parent(&scope);
+        Object condition = eval_expression(statement.children()[0]);
 
-        if (*static_cast<bool*>(condition.value.get()))
+        if (errorPending)
         {
-            run_block(statement.children[1], &ifScope);
-
-            if (ifScope.breakFlag)
-            {
-                diagnostics->add_error("Cannot break here.", statement.line, statement.lineColumn, statement.lineNumber);
-            }
-
-            if (ifScope.continueFlag)
-            {
-                diagnostics->add_error("Cannot continue here.", statement.line, statement.lineColumn, statement.lineNumber);
-            }
+            report_pending(statement);
+            return;
+        }
 
-            if (ifScope.returnFlag)
-            {
-                scope.returnFlag = true;
-            }
+        if (condition.boolValue)
+        {
+            run_block(statement.children()[1], result);
         }
-        else if (statement.children.size() == 3)
+        else if (statement.children().size() == 3)
         {
-            run_statement(statement.children[2], scope);
+            run_statement(statement.children()[2], result);
         }
     }
     // ELSE STATEMENT
     else if (statement.type == StatementType::ELSE)
     {
-        Scope elseScope;
-        elseScope.set_parent(&scope);
-
-        run_block(statement.children[0], &elseScope);
-
-        if (elseScope.breakFlag)
-        {
-            diagnostics->add_error("Cannot break here.", statement.line, statement.lineColumn, statement.lineNumber);
-        }
-
-        if (elseScope.continueFlag)
-        {
-            diagnostics->add_error("Cannot continue here.", statement.line, statement.lineColumn, statement.lineNumber);
-        }
-
-        if (elseScope.returnFlag)
-        {
-            scope.returnFlag = true;
-        }
+        run_block(statement.children()[0], result);
     }
     // WHILE STATEMENT
     else if (statement.type == StatementType::WHILE)
     {
-        Object condition = eval_expression(statement.children[0], scope);
+        // a loop with invariants starts a new stamp and gives the
+        // enclosing run of the same loop its stamp back at the end
+        SI_Loop* siLoop = static_cast<SI_Loop*>(statement.info);
+        unsigned int enclosingStamp = 0;
+
+        if (siLoop != nullptr)
+        {
+            enclosingStamp = siLoop->stamp;
+            siLoop->stamp = ++SI_Loop::lastStamp;
+        }
 
-        Scope whileScope;
-        whileScope.set_parent(&scope);
+        unsigned int backEdges = 0;
 
-        while (*static_cast<bool*>(condition.value.get()))
+        while (true)
         {
-            run_block(statement.children[1], &whileScope);
-            condition = eval_expression(statement.children[0], scope);
-            
-            if (whileScope.breakFlag)
+            // loops that keep going move to the virtual machine, the
+            // stack is all it needs to pick up where they are
+            if (loopThreshold > 0 && ++backEdges > loopThreshold)
+            {
+                run_compiled_loop(statement, result);
                 break;
+            }
 
-            if (whileScope.continueFlag)
+            Object condition = eval_expression(statement.children()[0]);
+
+            if (errorPending)
             {
-                whileScope.continueFlag = false;
-                continue;
+                report_pending(statement);
+                break;
             }
 
-            if (whileScope.returnFlag)
+            if (!condition.boolValue)
+                break;
+
+            run_block(statement.children()[1], result);
+            
+            if (breakFlag)
             {
-                scope.returnFlag = true;
+                breakFlag = false;
                 break;
             }
+
+            if (returnFlag)
+                break;
+
+            continueFlag = false;
         }
+
+        if (siLoop != nullptr)
+            siLoop->stamp = enclosingStamp;
     }
     // FUNCTION CALL STATEMENT
     else if (statement.type == StatementType::FUNCTION_CALL)
     {
-        run_function_call(statement, scope);
+        eval_expression(statement);
+
+        if (errorPending)
+            report_pending(statement);
     }
+    // RETURN STATEMENT
     else if (statement.type == StatementType::RETURN)
     {
-        if (result != nullptr)
+        const Statement* returned = &statement.children()[0];
+
+        while (returned->type == StatementType::EXP)
+            returned = &returned->children()[0];
+
+        // the call runs after this function returned
+        if (result != nullptr && returned->type == StatementType::FUNCTION_CALL && static_cast<SI_FunctionCall*>(returned->info)->tail)
+        {
+            prepare_tail_call(statement, *returned, result);
+        }
+        else if (result != nullptr)
         {
-            Object evaluatedObject = eval_expression(statement.children[0], scope);
-            result->type == evaluatedObject.type;
-            result->value = evaluatedObject.value;
+            Object value = eval_expression(statement.children()[0]);
+
+            if (errorPending)
+            {
+                report_pending(statement);
+                return;
+            }
+
+            *result = static_cast<Object&&>(value);
+            returnFlag = true;
         }
         else
         {
-            diagnostics->add_error("Cannot return here.", statement.line, statement.lineColumn, statement.lineNumber);
+            report("Cannot return here.", statement);
         }
     }
+    // BREAK STATEMENT
+    else if (statement.type == StatementType::BREAK)
+    {
+        breakFlag = true;
+    }
+    // CONTINUE STATEMENT
+    else if (statement.type == StatementType::CONTINUE)
+    {
+        continueFlag = true;
+    }
     else
     {
-        diagnostics->add_error("Bad statement!", statement.line, statement.lineColumn, statement.lineNumber);
+        report("Bad statement!", statement);
+    }
+}
+
+/**
+ * Calls a native function. Errors are reported at the call
+ * and the call evaluates to nil. Natives report their errors
+ * by throwing, so only the native itself is guarded.
+*/
+Object Runner::run_native_call(const Statement& nativeCall, const Native& native)
+{
+    Object arguments[MAX_NATIVE_ARITY];
+
+    for (unsigned int i = 0; i < native.arity; ++i)
+    {
+        arguments[i] = eval_expression(nativeCall.children()[i]);
+
+        if (errorPending)
+        {
+            report_pending(nativeCall);
+            return Object();
+        }
+    }
+
+    try
+    {
+        return native.function(arguments);
+    }
+    catch (const std::exception& exp)
+    {
+        report(exp.what(), nativeCall);
     }
+
+    return Object();
 }
 
-Object Runner::run_function_call(Statement& functionCall, Scope& scope)
+/**
+ * Finds the function a call calls. Reports an error
+ * at the call and returns nullptr if it can not be called.
+*/
+Statement* Runner::find_function(const Statement& functionCall)
 {
-    SI_String siFunctionCall = *static_cast<SI_String*>(functionCall.info.get());
+    SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(functionCall.info);
+    Statement* function = siFunctionCall->callee;
 
-    if (siFunctionCall.value == "print")
+    // the same functions can be called as last time
+    if (function == nullptr || siFunctionCall->calleeEpoch != stack.get_function_epoch())
     {
-        try
+        function = stack.get_function_in_block(siFunctionCall->symbol);
+
+        if (function == nullptr)
         {
-            if (functionCall.children.size() == 1)
-                std::cout << *static_cast<std::string*>(eval_expression(functionCall.children[0], scope).to_string().value.get()) << std::endl;
+            report("The function with the name " + SymbolTable::global().get_name(siFunctionCall->symbol) + " has not been defined!", functionCall);
+            return nullptr;
         }
-        catch (const std::exception& exp)
+
+        if (static_cast<SI_Function*>(function->info)->parameterNames.size() != functionCall.children().size()) 
         {
-            diagnostics->add_error(exp.what(), functionCall.line, functionCall.lineColumn, functionCall.lineNumber);
+            report("Inccorect number of parameters!", functionCall);
+            return nullptr; 
         }
+
+        siFunctionCall->callee = function;
+        siFunctionCall->calleeEpoch = stack.get_function_epoch();
     }
-    else
+
+    return function;
+}
+
+/**
+ * Counts a call of a function, if it is hot the virtual machine runs it.
+*/
+bool Runner::is_hot(SI_Function& function)
+{
+    return function.entry >= 0 || (callThreshold > 0 && ++function.calls >= callThreshold);
+}
+
+/**
+ * Evaluates the arguments of a returned tail call in the frame of the
+ * returning function, the call itself runs once the frame is gone.
+ * Fails just like returning the call would.
+*/
+void Runner::prepare_tail_call(const Statement& returnStatement, const Statement& functionCall, Object* result)
+{
+    Statement* function = find_function(functionCall);
+
+    if (function == nullptr)
+    {
+        *result = Object();
+        returnFlag = true;
+        return;
+    }
+
+    // the arguments can make tail calls of their own
+    std::vector<Object> arguments;
+    arguments.reserve(functionCall.children().size());
+
+    for (auto& argument : functionCall.children())
     {
-        Statement* function = scope.get_function_in_block(siFunctionCall.value);
+        arguments.push_back(eval_expression(argument));
 
-        if (function != nullptr)
+        if (errorPending)
         {
-            SI_Function* siFunction = static_cast<SI_Function*>(function->info.get());
-            
-            Scope functionScope;
-            functionScope.set_parent(&scope);
-            functionScope.create_function_table(function->children[0]);
+            report_pending(returnStatement);
+            return;
+        }
+    }
 
-            if (siFunction->parameterNames.size() != functionCall.children.size()) 
-            {
-                diagnostics->add_error("Inccorect number of parameters!", functionCall.line, functionCall.lineColumn, functionCall.lineNumber);
-                return Object(); 
-            }
+    *result = Object();
+    returnFlag = true;
+    tailCall = function;
+    tailArguments.swap(arguments);
+}
 
-            for (int i = 0; i < siFunction->parameterNames.size(); i++)
-            {
-                functionScope.set_variable(siFunction->parameterNames[i], eval_expression(functionCall.children[i], scope));
-            }
+/**
+ * Calls a user defined function. Tail calls of the function run
+ * in its place, one after the other, instead of nesting. A memoized
+ * function called with the same arguments as before does not run.
+*/
+Object Runner::run_function_call(const Statement& functionCall)
+{
+    Statement* function = find_function(functionCall);
+
+    if (function == nullptr)
+        return Object();
+
+    SI_Function* siFunction = static_cast<SI_Function*>(function->info);
+
+    if (is_hot(*siFunction) || callDepth >= WALK_DEPTH)
+    {
+        std::vector<Object> arguments;
+        arguments.reserve(functionCall.children().size());
+
+        for (auto& argument : functionCall.children())
+        {
+            arguments.push_back(eval_expression(argument));
+
+            if (errorPending)
+                return Object();
+        }
+
+        if (callDepth >= depthLimit)
+            throw RecursionLimit{ &functionCall };
+
+        return run_compiled_function(*function, arguments);
+    }
+    
+    // the arguments become the first slots of the new frame
+    // and stay nameless until every one has been evaluated
+    unsigned int frameBase = stack.get_top();
+
+    for (auto& argument : functionCall.children())
+    {
+        stack.push_argument(eval_expression(argument));
+
+        if (errorPending)
+        {
+            stack.unwind(frameBase);
+            return Object();
+        }
+    }
+
+    if (callDepth >= depthLimit)
+        throw RecursionLimit{ &functionCall };
+
+    unsigned int callerBase = stack.enter_frame(frameBase, siFunction->parameterNames);
+
+    const Statement* called = function;
+    bool memoized = siFunction->memoized && memo.enabled() && !hasErrors && MemoCache::pays_off(*siFunction);
+    std::vector<Object> arguments;
+
+    if (memoized)
+    {
+        for (unsigned int i = 0; i < siFunction->parameterNames.size(); ++i)
+            arguments.push_back(stack.frame()[i].value);
+
+        if (const Object* cached = memo.find(called, arguments.data(), arguments.size()))
+        {
+            stack.exit_frame(callerBase);
+            return *cached;
+        }
+    }
+
+    ++callDepth;
+
+    Object result;
+    run_block(function->children()[0], &result);
+    returnFlag = false;
+
+    while (tailCall != nullptr)
+    {
+        function = tailCall;
+        siFunction = static_cast<SI_Function*>(function->info);
+        tailCall = nullptr;
+
+        stack.exit_frame(callerBase);
+
+        if (is_hot(*siFunction))
+        {
+            --callDepth;
+            result = run_compiled_function(*function, tailArguments);
+
+            if (memoized && !hasErrors)
+                memo.insert(called, arguments.data(), arguments.size(), result);
 
-            Object result;
-            run_block(function->children[0], &functionScope, &result);
             return result;
         }
-        else
+
+        frameBase = stack.get_top();
+
+        for (auto& argument : tailArguments)
+            stack.push_argument(argument);
+
+        callerBase = stack.enter_frame(frameBase, siFunction->parameterNames);
+
+        result = Object();
+        run_block(function->children()[0], &result);
+        returnFlag = false;
+    }
+
+    stack.exit_frame(callerBase);
+    --callDepth;
+
+    if (memoized && !hasErrors)
+        memo.insert(called, arguments.data(), arguments.size(), result);
+
+    return result;
+}
+
+/**
+ * Applies an operator to its evaluated operands. The statement specializes
+ * itself on the types of its first operands, after that only a guard on
+ * the operand types is checked. A guard that fails turns the statement
+ * generic for good. Operators the type checker typed skip the guard.
+*/
+template <typename Operator>
+Object Runner::apply_operator(const Statement& statement, Object left, const Object& right)
+{
+    switch (statement.specialization)
+    {
+    case Specialization::INT32:
+        if (left.type == ObjectType::INT32 && right.type == ObjectType::INT32)
+            return Operator::apply(left.int32Value, right.int32Value);
+        statement.specialization = Specialization::GENERIC;
+        break;
+    case Specialization::FLOAT32:
+        if constexpr (Operator::hasFloat32)
+        {
+            if (left.type == ObjectType::FLOAT32 && right.type == ObjectType::FLOAT32)
+                return Operator::apply(left.float32Value, right.float32Value);
+        }
+        statement.specialization = Specialization::GENERIC;
+        break;
+    case Specialization::STRING:
+        if constexpr (Operator::hasString)
+        {
+            if (left.type == ObjectType::STRING && right.type == ObjectType::STRING)
+                return Operator::apply(left.as_string(), right.as_string());
+        }
+        statement.specialization = Specialization::GENERIC;
+        break;
+    case Specialization::NONE:
+        statement.specialization = specialize<Operator>(left, right);
+        break;
+    case Specialization::GENERIC:
+        break;
+    case Specialization::TYPED_INT32:
+        return Operator::apply(left.int32Value, right.int32Value);
+    case Specialization::TYPED_FLOAT32:
+        if constexpr (Operator::hasFloat32)
+            return Operator::apply(left.float32Value, right.float32Value);
+        break;
+    case Specialization::TYPED_STRING:
+        if constexpr (Operator::hasString)
+            return Operator::apply(left.as_string(), right.as_string());
+        break;
+    }
+
+    if (!left.try_apply(Operator::op, right))
+        return fail(Object::binary_error(Operator::op));
+
+    return left;
+}
+
+/**
+ * Evaluates an operator. The first few operators of a chain recurse
+ * into their first operand, the rest of the chain is evaluated in a
+ * loop, so a long chain takes no more C++ stack than a short one.
+*/
+template <typename Operator>
+Object Runner::eval_operator(const Statement& statement)
+{
+    const Statement& first = statement.children()[0];
+    Object left;
+
+    if (!is_binary_operator(first.type))
+        left = eval_expression(first);
+    else if (operatorDepth < NESTED_OPERATORS)
+    {
+        ++operatorDepth;
+        left = eval_expression(first);
+        --operatorDepth;
+    }
+    else
+        left = eval_operators(first);
+
+    if (errorPending)
+        return Object();
+
+    Object right = eval_expression(statement.children()[1]);
+
+    if (errorPending)
+        return Object();
+
+    return apply_operator<Operator>(statement, std::move(left), right);
+}
+
+/**
+ * Evaluates a chain of operators from its first operand up. The
+ * operators wait on a stack shared with the chains in their operands.
+*/
+Object Runner::eval_operators(const Statement& chain)
+{
+    unsigned int mark = operators.size();
+    Object left = eval_expression(collect_operator_chain(chain, operators));
+
+    while (operators.size() > mark)
+    {
+        const Statement& statement = *operators.back();
+        operators.pop_back();
+
+        if (errorPending)
+            break;
+
+        Object right = eval_expression(statement.children()[1]);
+
+        if (errorPending)
+            break;
+
+        switch (statement.type)
         {
-            diagnostics->add_error("The function with the name " + siFunctionCall.value + " has not been defined!", functionCall.line, functionCall.lineColumn, functionCall.lineNumber);
+        case StatementType::ADD_OP: left = apply_operator<AddOperator>(statement, std::move(left), right); break;
+        case StatementType::SUB_OP: left = apply_operator<SubOperator>(statement, std::move(left), right); break;
+        case StatementType::MULT_OP: left = apply_operator<MultOperator>(statement, std::move(left), right); break;
+        case StatementType::DIV_OP: left = apply_operator<DivOperator>(statement, std::move(left), right); break;
+        case StatementType::MOD_OP: left = apply_operator<ModOperator>(statement, std::move(left), right); break;
+        case StatementType::EQUALS_OP: left = apply_operator<EqualsOperator>(statement, std::move(left), right); break;
+        case StatementType::NEQUALS_OP: left = apply_operator<NequalsOperator>(statement, std::move(left), right); break;
+        case StatementType::GTHANE_OP: left = apply_operator<GthaneOperator>(statement, std::move(left), right); break;
+        case StatementType::LTHANE_OP: left = apply_operator<LthaneOperator>(statement, std::move(left), right); break;
+        case StatementType::GTHAN_OP: left = apply_operator<GthanOperator>(statement, std::move(left), right); break;
+        case StatementType::LTHAN_OP: left = apply_operator<LthanOperator>(statement, std::move(left), right); break;
+        default: break;
         }
     }
 
-    return Object();
+    if (errorPending)
+    {
+        operators.resize(mark);
+        return Object();
+    }
+
+    return left;
 }
 
 /**
  * Evaluates an expression.
 */
-Object Runner::eval_expression(const Statement& statement, Scope& scope)
+Object Runner::eval_expression(const Statement& statement)
 {
     switch (statement.type)
     {
     case StatementType::FUNCTION_CALL:
-        if (SI_String* siString = static_cast<SI_String*>(statement.info.get()))
+        if (SI_FunctionCall* siFunctionCall = static_cast<SI_FunctionCall*>(statement.info))
         {
-            try
-            {
-                if (siString->value == "int" && statement.children.size() == 1)
-                {
-                    return eval_expression(statement.children[0], scope).to_int32();
-                }
-                else if (siString->value == "float" && statement.children.size() == 1)
-                {
-                    return eval_expression(statement.children[0], scope).to_float32();
-                }
-                else if (siString->value == "bool" && statement.children.size() == 1)
-                {
-                    return eval_expression(statement.children[0], scope).to_bool();
-                }
-                else if (siString->value == "char" && statement.children.size() == 1)
-                {
-                    return eval_expression(statement.children[0], scope).to_char();
-                }
-                else if (siString->value == "str" && statement.children.size() == 1)
-                {
-                    return eval_expression(statement.children[0], scope).to_string();
-                }
-            }
-            catch (const std::exception& exp)
+            if (siFunctionCall->native >= 0)
+                return run_native_call(statement, NativeTable::global().get_native(siFunctionCall->native));
+
+            return run_function_call(statement);
+        }
+        break;
+    case StatementType::CONSTANT:
+        {
+            return static_cast<SI_Constant*>(statement.info)->value;
+        }
+        break;
+    case StatementType::INVARIANT:
+        if (SI_Invariant* siInvariant = static_cast<SI_Invariant*>(statement.info))
+        {
+            if (siInvariant->stamp == siInvariant->loop->stamp)
+                return siInvariant->value;
+
+            Object value = eval_expression(statement.children()[0]);
+
+            if (errorPending)
+                return Object();
+
+            siInvariant->value = value;
+            siInvariant->stamp = siInvariant->loop->stamp;
+            return value;
+        }
+        break;
+    case StatementType::INLINE:
+        {
+            // an inlined function reports its errors where it returns
+            Object value = eval_expression(statement.children()[0]);
+
+            if (errorPending)
             {
-                diagnostics->add_error(exp.what(), statement.line, statement.lineColumn, statement.lineNumber);
+                report_pending(statement);
+                return Object();
             }
+
+            return value;
         }
         break;
     case StatementType::EXP:
         {
-            return eval_expression(statement.children[0], scope);
+            return eval_expression(statement.children()[0]);
         }
         break;
     case StatementType::STRING:
-        if (SI_String* siString = static_cast<SI_String*>(statement.info.get()))
+        if (SI_String* siString = static_cast<SI_String*>(statement.info))
         {
-            Object _string;
-            _string.type = ObjectType::STRING;
-            _string.value = std::make_shared<std::string>(siString->value);
-            return _string;
+            return Object::make_string(siString->value);
         }
         break;
     case StatementType::BOOLEAN:
-        if (SI_Boolean* siBoolean = static_cast<SI_Boolean*>(statement.info.get())) 
+        if (SI_Boolean* siBoolean = static_cast<SI_Boolean*>(statement.info)) 
         {
-            Object boolean;
-            boolean.type = ObjectType::BOOL;
-            boolean.value = std::make_shared<bool>(siBoolean->value);
-            return boolean;
+            return Object::make_bool(siBoolean->value);
         }
         break;
     case StatementType::VARIABLE:
-        if (SI_String* siVariable = static_cast<SI_String*>(statement.info.get()))
+        if (SI_Variable* siVariable = static_cast<SI_Variable*>(statement.info))
         {
-            return scope.get_variable(siVariable->value);
+            if (siVariable->slot >= 0)
+                return stack.local(siVariable->slot);
+
+            return stack.get_variable(siVariable->symbol);
         }
         break;
     case StatementType::NUMBER:
-        if (SI_String* siNumber = static_cast<SI_String*>(statement.info.get()))
+        if (SI_String* siNumber = static_cast<SI_String*>(statement.info))
         {
-            Object number;
-            
             /**
              * If the number is a floating point number.
             */
-            if (siNumber->value.find('.') != std::string::npos)
+            try
             {
-                number.type = ObjectType::FLOAT32;
-                number.value = std::make_shared<float>(std::stof(siNumber->value));
-                return number;
+                if (siNumber->value.find('.') != std::string::npos)
+                {
+                    return Object::make_float32(std::stof(siNumber->value));
+                }
+                /**
+                 * If the number is an integer.
+                */
+                else
+                {
+                    return Object::make_int32(std::stoi(siNumber->value));
+                }
             }
-            /**
-             * If the number is an integer.
-            */
-            else
+            catch (const std::exception& exp)
             {
-                number.type = ObjectType::INT32;
-                number.value = std::make_shared<int>(std::stoi(siNumber->value));
-                return number;
-            } 
+                return fail(exp.what());
+            }
         }
         break;
     case StatementType::CHAR:
-        if (SI_String* siChar = static_cast<SI_String*>(statement.info.get()))
+        if (SI_String* siChar = static_cast<SI_String*>(statement.info))
         {
-            Object _char;
-            _char.type = ObjectType::CHAR;
-            _char.value = std::make_shared<char>(siChar->value[0]);
-            return _char;
+            return Object::make_char(siChar->value[0]);
         }
         break;
     case StatementType::ADD_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left + right;
-        }
-        break;
+        return eval_operator<AddOperator>(statement);
     case StatementType::SUB_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left - right;
-        }
-        break;
+        return eval_operator<SubOperator>(statement);
     case StatementType::MULT_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left * right;
-        }
-        break;
+        return eval_operator<MultOperator>(statement);
     case StatementType::DIV_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left / right;
-        }
-        break;
+        return eval_operator<DivOperator>(statement);
     case StatementType::MOD_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left % right;
-        }
-        break;
+        return eval_operator<ModOperator>(statement);
     case StatementType::EQUALS_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left == right;
-        }
-        break;
+        return eval_operator<EqualsOperator>(statement);
     case StatementType::NEQUALS_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left != right;
-        }
-        break;
+        return eval_operator<NequalsOperator>(statement);
     case StatementType::GTHANE_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left >= right;
-        }
-        break;
+        return eval_operator<GthaneOperator>(statement);
     case StatementType::LTHANE_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left <= right;
-        }
-        break;
+        return eval_operator<LthaneOperator>(statement);
     case StatementType::GTHAN_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left > right;
-        }
-        break;
+        return eval_operator<GthanOperator>(statement);
     case StatementType::LTHAN_OP:
-        {
-            Object left = eval_expression(statement.children[0], scope);
-            Object right = eval_expression(statement.children[1], scope);
-            return left < right;
-        }
-        break;
+        return eval_operator<LthanOperator>(statement);
     case StatementType::NEGATE_OP:
         {
-            Object result = eval_expression(statement.children[0], scope);
-            return -result;
+            Object result = eval_expression(statement.children()[0]);
+
+            if (errorPending)
+                return Object();
+
+            if (!result.try_negate())
+                return fail("Unable to negate object!");
+
+            return result;
         }
         break;
     }
 
-    Object nil;
-    nil.type = ObjectType::NIL;
-    return nil;
+    return Object();
+}
+
+/**
+ * Compiles the script for the virtual machine, the first
+ * time a function or loop gets hot.
+*/
+void Runner::tier_up()
+{
+    if (program != nullptr)
+        return;
+
+    compiler = std::make_unique<Compiler>();
+    program = compiler->compile(root);
+
+    vm = std::make_unique<VirtualMachine>(stack, memo);
+    vm->set_jit_enabled(jitEnabled);
+}
+
+/**
+ * Calls a hot function through the virtual machine.
+*/
+Object Runner::run_compiled_function(Statement& function, const std::vector<Object>& arguments)
+{
+    SI_Function* siFunction = static_cast<SI_Function*>(function.info);
+
+    if (siFunction->entry < 0)
+    {
+        tier_up();
+        siFunction->entry = compiler->compile_entry(function);
+    }
+
+    // the calls the virtual machine makes count from the ones walked
+    vm->set_depth_limit(depthLimit - callDepth);
+
+    Object result = vm->run_chunk(program, diagnostics, siFunction->entry, arguments);
+    hasErrors = diagnostics->has_errors();
+    return result;
+}
+
+/**
+ * Runs the rest of a hot loop in the virtual machine. A loop
+ * of a function can return from it, into the result.
+*/
+void Runner::run_compiled_loop(Statement& loop, Object* result)
+{
+    tier_up();
+
+    auto loopChunk = loopChunks.find(&loop);
+
+    if (loopChunk == loopChunks.end())
+        loopChunk = loopChunks.emplace(&loop, compiler->compile_loop(loop)).first;
+
+    vm->set_depth_limit(depthLimit - callDepth);
+
+    Object value = vm->run_chunk(program, diagnostics, loopChunk->second, {});
+    hasErrors = diagnostics->has_errors();
+
+    if (vm->has_returned())
+    {
+        *result = static_cast<Object&&>(value);
+        returnFlag = true;
+    }
 }
 
 #pragma endregion
 
 #pragma region Public Methods
 
+Runner::Runner()
+{
+    tailCall = nullptr;
+    program = nullptr;
+    callDepth = 0;
+    operatorDepth = 0;
+    depthLimit = RecursionLimit::DEFAULT;
+    callThreshold = CALL_THRESHOLD;
+    loopThreshold = LOOP_THRESHOLD;
+    jitEnabled = true;
+}
+
+Runner::~Runner() = default;
+
+/**
+ * Sets how many calls make a function hot and how many rounds make a
+ * loop hot. Zero keeps them in the runner.
+*/
+void Runner::set_thresholds(unsigned int callThreshold, unsigned int loopThreshold)
+{
+    this->callThreshold = callThreshold;
+    this->loopThreshold = loopThreshold;
+}
+
 void Runner::run(Statement* root, Diagnostics* diagnostics)
 {
     this->root = root;
     this->diagnostics = diagnostics;
-    run_block(*root, nullptr);
+    returnFlag = false;
+    breakFlag = false;
+    continueFlag = false;
+    errorPending = false;
+    tailCall = nullptr;
+    callDepth = 0;
+    hasErrors = diagnostics->has_errors();
+
+    stack.reset();
+    memo.clear();
+    operators.clear();
+    operatorDepth = 0;
+
+    try
+    {
+        run_block(*root);
+    }
+    catch (const RecursionLimit& limit)
+    {
+        report("Maximum recursion depth exceeded!", *limit.functionCall);
+    }
 }
 
 void Runner::test1()
 {
-    Statement add;
-    add.type = StatementType::ADD_OP;
-    
-    Statement left;
-    left.type = StatementType::NUMBER;
-    std::shared_ptr<SI_String> leftIsNumber = std::make_shared<SI_String>();
+    errorPending = false;
+
+    Ast ast;
+    std::vector<Statement> pending;
+
+    Statement left(StatementType::NUMBER, 0, 0);
+    SI_String* leftIsNumber = ast.make_info<SI_String>();
     leftIsNumber->value = "10";
     left.info = leftIsNumber;
 
-    Statement right;
-    right.type = StatementType::NUMBER;
-    std::shared_ptr<SI_String> rightIsNumber = std::make_shared<SI_String>();
+    Statement right(StatementType::NUMBER, 0, 0);
+    SI_String* rightIsNumber = ast.make_info<SI_String>();
     rightIsNumber->value = "10";
     right.info = rightIsNumber;
 
-    add.children.push_back(left);
-    add.children.push_back(right);
+    pending.push_back(left);
+    pending.push_back(right);
+
+    Statement add(StatementType::ADD_OP, 0, 0);
+    ast.add_children(add, pending, 0);
 
-    Scope scope;
-    Object result = eval_expression(add, scope);
+    Object result = eval_expression(*ast.add_root(add));
     result.print();
 }
 
@@ -5,62 +5,181 @@
 #include <string>
 #include <memory>
 #include <stdexcept>
+#include <unordered_map>
 
 #include "parser.hpp"
 #include "object.hpp"
+#include "natives.hpp"
+#include "compiler.hpp"
+#include "memo.hpp"
 
 namespace pop
 {
+    class VirtualMachine;
+
     /**
      * A structure basically made for stack variables.
+     * Slots that are not declared yet have no name.
     */
     struct StackAllocation
     {
-        std::string variableName;
+        Symbol variableName;
         Object value;
     };
 
     /**
-     * A scope is exactly what it sounds like
-     * ... a scope.
+     * Ends a script whose calls nest deeper than the recursion limit.
+     * It is not a std::exception, so nothing on the way out catches
+     * it and reports the failing call on every level.
     */
-    struct Scope
+    struct RecursionLimit
     {
-    private:
-        Scope* parent;
-        std::vector<StackAllocation> stack;
+        static const unsigned int DEFAULT = 100000;
+
+        const Statement* functionCall;
+    };
+
+    /**
+     * Every variable of every running block and function lives
+     * in one contiguous stack of slots. A function call starts a
+     * new frame at the top of the stack and the resolver's slots
+     * are counted from the base of that frame. Blocks only move
+     * the top, so nothing is allocated once the stack has grown.
+     *
+     * The function epoch names the set of functions that can be
+     * called. It changes whenever a block defining functions is
+     * entered and comes back when that block is left, so a call
+     * site can keep the function it found as long as the epoch
+     * is the same.
+    */
+    class Stack
+    {
+        /**
+         * Where a running block started.
+        */
+        struct BlockMark
+        {
+            unsigned int top;
+            unsigned int functionCount;
+            unsigned int functionEpoch;
+        };
+
+        static unsigned int lastFunctionEpoch;
+
+        std::vector<StackAllocation> slots;
         std::vector<Statement*> functions;
+        std::vector<BlockMark> blocks;
+        unsigned int base;
+        unsigned int top;
+        unsigned int functionEpoch;
+
+        void grow();
+        void clear_to(unsigned int newTop);
 
     public:
-        bool returnFlag;
-        bool breakFlag;
-        bool continueFlag;
+        Stack();
+
+        Object& local(unsigned int slot) { return slots[base + slot].value; }
+        StackAllocation* frame() { return slots.data() + base; }
+        Object get_variable(Symbol variableName);
+        bool set_variable(Symbol variableName, const Object& value);
+        void declare_variable(unsigned int slot, Symbol variableName, Object value);
+        void push_argument(Object value);
+        unsigned int get_top() const { return top; }
+        unsigned int get_block_depth() const { return blocks.size(); }
+        unsigned int get_function_epoch() const { return functionEpoch; }
 
-        Scope();
+        void enter_block(Statement& block);
+        void exit_block();
+        unsigned int enter_frame(unsigned int frameBase, const std::vector<Symbol>& parameterNames);
+        void exit_frame(unsigned int callerBase);
+        void unwind(unsigned int newTop);
+        void reset();
 
-        bool has_variable(const std::string& variableName);
-        Object get_variable(const std::string& variableName);
-        void set_variable(const std::string& variableName, Object value);
-        void set_parent(Scope* parent);
-        void create_function_table(Statement& block);
-        Statement* get_function_in_block(std::string functionName);
-        std::vector<StackAllocation>& get_stack();
+        Statement* get_function_in_block(Symbol functionName);
     };
 
     /**
      * Executes an abstract syntax tree.
+     *
+     * Errors in expressions do not unwind the runner. The failing
+     * expression leaves the error pending and evaluates to nil, and
+     * the statement it escapes from reports it at its own location.
+     *
+     * Scripts start out walked. Functions called often and loops that
+     * keep going are handed to the virtual machine, which runs them on
+     * the same stack. The script is only compiled
+     * once something gets hot, so short scripts never pay for it.
+     *
+     * Walking a call takes several C++ frames, so calls nested deeper
+     * than a few levels go to the virtual machine as well, whose frames
+     * live on the heap. Deep recursion ends at the recursion limit.
+     *
+     * Both share a memo cache for the results of pure functions.
     */
     class Runner 
     {
+        static const unsigned int CALL_THRESHOLD = 500;
+        static const unsigned int LOOP_THRESHOLD = 1000;
+        static const unsigned int WALK_DEPTH = 64;
+        static const unsigned int NESTED_OPERATORS = 16;
+
         Statement* root;
         Diagnostics* diagnostics;
+        Stack stack;
+        MemoCache memo;
+        bool returnFlag;
+        bool breakFlag;
+        bool continueFlag;
+        bool hasErrors;
+        bool errorPending;
+        std::string pendingError;
+        Statement* tailCall;
+        std::vector<Object> tailArguments;
+        std::vector<const Statement*> operators;   // of the chains being evaluated
+        unsigned int operatorDepth;                 // operators recursing into their first operand
+
+        // the optimized tier
+        std::unique_ptr<Compiler> compiler;
+        std::unique_ptr<VirtualMachine> vm;
+        Program* program;
+        std::unordered_map<const Statement*, unsigned int> loopChunks;
+        unsigned int callThreshold;
+        unsigned int loopThreshold;
+        bool jitEnabled;
+        unsigned int callDepth;
+        unsigned int depthLimit;
+
+        void report(const std::string& message, const Statement& statement);
+        void report_pending(const Statement& statement);
+        Object fail(const std::string& message);
 
-        void run_block(Statement& root, Scope* parentScope, Object* result = nullptr);
-        void run_statement(Statement& statement, Scope& scope, Object* result = nullptr);
-        Object run_function_call(Statement& functionCall, Scope& scope);
-        Object eval_expression(const Statement& statement, Scope& scope);
+        void run_block(Statement& root, Object* result = nullptr);
+        void run_statement(Statement& statement, Object* result = nullptr);
+        Object run_native_call(const Statement& nativeCall, const Native& native);
+        Statement* find_function(const Statement& functionCall);
+        bool is_hot(SI_Function& function);
+        void prepare_tail_call(const Statement& returnStatement, const Statement& functionCall, Object* result);
+        Object run_function_call(const Statement& functionCall);
+        template <typename Operator>
+        Object apply_operator(const Statement& statement, Object left, const Object& right);
+        template <typename Operator>
+        Object eval_operator(const Statement& statement);
+        Object eval_operators(const Statement& chain);
+        Object eval_expression(const Statement& statement);
+
+        void tier_up();
+        Object run_compiled_function(Statement& function, const std::vector<Object>& arguments);
+        void run_compiled_loop(Statement& loop, Object* result);
 
     public:
+        Runner();
+        ~Runner();
+
+        void set_thresholds(unsigned int callThreshold, unsigned int loopThreshold);
+        void set_jit_enabled(bool enabled) { jitEnabled = enabled; }
+        void set_depth_limit(unsigned int limit) { depthLimit = limit; }
+        void set_memo_capacity(std::size_t bytes) { memo.set_capacity(bytes); }
         void run(Statement* root, Diagnostics* diagnostics);
         void test1();
     };
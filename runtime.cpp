@@ -0,0 +1,309 @@
+#include "runtime.hpp"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+using namespace pop;
+
+// emitted calls nest on the C++ stack, so the script runs on a stack
+// big enough for the recursion limit, whatever the system gives main
+static const std::size_t SCRIPT_STACK_SIZE = 1024ul * 1024 * 1024;
+static const std::size_t DEFAULT_STACK_SIZE = 8 * 1024 * 1024;
+static const std::size_t STACK_MARGIN = 256 * 1024;
+
+Runtime::Runtime()
+{
+    hasErrors = false;
+    lastLoopStamp = 0;
+    tailCall = nullptr;
+    callDepth = 0;
+    stackEnd = 0;
+    diagnostics.set_file(&file);
+}
+
+#pragma region Setup
+
+/**
+ * Adds the next line of the source, errors show the line they are on.
+*/
+void Runtime::add_line(const char* line)
+{
+    file.add_line(line);
+}
+
+/**
+ * Adds a user function, blocks make it callable.
+*/
+Statement* Runtime::add_function(const char* name, std::initializer_list<const char*> parameterNames, EmittedBody body)
+{
+    infos.push_back(std::make_unique<SI_Emitted>());
+    SI_Emitted* siEmitted = static_cast<SI_Emitted*>(infos.back().get());
+    siEmitted->functionName = intern(name);
+    siEmitted->body = body;
+
+    for (auto& parameterName : parameterNames)
+        siEmitted->parameterNames.push_back(intern(parameterName));
+
+    statements.emplace_back(StatementType::FUNCTION, 0, 0);
+    statements.back().info = siEmitted;
+    return &statements.back();
+}
+
+/**
+ * Adds a block that defines the given functions.
+*/
+Statement* Runtime::add_block(std::initializer_list<Statement*> functions)
+{
+    infos.push_back(std::make_unique<SI_Block>());
+    SI_Block* siBlock = static_cast<SI_Block*>(infos.back().get());
+    siBlock->functions = functions;
+
+    statements.emplace_back(StatementType::BLOCK, 0, 0);
+    statements.back().info = siBlock;
+    return &statements.back();
+}
+
+Symbol Runtime::intern(const char* name)
+{
+    return SymbolTable::global().intern(name);
+}
+
+/**
+ * Gets the index of a native function the script calls.
+*/
+unsigned int Runtime::find_native(const char* name)
+{
+    int native = NativeTable::global().find_native(intern(name));
+
+    if (native < 0)
+        throw std::runtime_error("The native function " + std::string(name) + " has not been added!");
+
+    return native;
+}
+
+#pragma endregion
+
+#pragma region Running
+
+/**
+ * Adds an error at a location of the source.
+*/
+void Runtime::report(const std::string& message, unsigned int lineColumn, unsigned int lineNumber)
+{
+    diagnostics.add_error(message, lineColumn, lineNumber);
+    hasErrors = true;
+}
+
+/**
+ * Calls a native function, its errors are reported at the call
+ * and the call evaluates to nil.
+*/
+Object Runtime::call_native(unsigned int native, Object* arguments, unsigned int lineColumn, unsigned int lineNumber)
+{
+    try
+    {
+        return NativeTable::global().get_native(native).function(arguments);
+    }
+    catch (const std::exception& exp)
+    {
+        report(exp.what(), lineColumn, lineNumber);
+    }
+
+    return Object();
+}
+
+/**
+ * Finds the function a call site calls. Reports an error at
+ * the call and returns nullptr if it can not be called.
+*/
+SI_Emitted* Runtime::find_function(EmittedCall& call)
+{
+    // the same functions can be called as last time
+    if (call.callee == nullptr || call.calleeEpoch != stack.get_function_epoch())
+    {
+        Statement* function = stack.get_function_in_block(call.functionName);
+
+        if (function == nullptr)
+        {
+            report("The function with the name " + SymbolTable::global().get_name(call.functionName) + " has not been defined!", call.lineColumn, call.lineNumber);
+            return nullptr;
+        }
+
+        if (static_cast<SI_Function*>(function->info)->parameterNames.size() != call.argumentCount)
+        {
+            report("Inccorect number of parameters!", call.lineColumn, call.lineNumber);
+            return nullptr;
+        }
+
+        call.callee = function;
+        call.calleeEpoch = stack.get_function_epoch();
+    }
+
+    return static_cast<SI_Emitted*>(call.callee->info);
+}
+
+/**
+ * Runs a user function on the arguments pushed from frame base on.
+ * Tail calls of the function run in its place, one after the other,
+ * instead of nesting.
+*/
+Object Runtime::invoke(const SI_Emitted& function, unsigned int frameBase, const EmittedCall& call)
+{
+    char here;
+
+    if (callDepth >= RecursionLimit::DEFAULT || reinterpret_cast<std::uintptr_t>(&here) < stackEnd)
+        throw EmittedRecursionLimit{ &call };
+
+    unsigned int callerBase = stack.enter_frame(frameBase, function.parameterNames);
+
+    ++callDepth;
+    Object result = function.body();
+
+    while (tailCall != nullptr)
+    {
+        const SI_Emitted* callee = tailCall;
+        tailCall = nullptr;
+
+        stack.exit_frame(callerBase);
+        frameBase = stack.get_top();
+
+        for (auto& argument : tailArguments)
+            stack.push_argument(argument);
+
+        callerBase = stack.enter_frame(frameBase, callee->parameterNames);
+        result = callee->body();
+    }
+
+    stack.exit_frame(callerBase);
+    --callDepth;
+    return result;
+}
+
+/**
+ * Returns a call from a function, the call runs once the
+ * function has returned and its frame is gone.
+*/
+Object Runtime::tail_call(const SI_Emitted& function, std::initializer_list<Object> arguments)
+{
+    tailCall = &function;
+    tailArguments.assign(arguments);
+    return Object();
+}
+
+/**
+ * Applies an operator to operands of types that are not known.
+*/
+Object Runtime::apply(BinaryOp op, Operands operands)
+{
+    if (!operands.left.try_apply(op, operands.right))
+        throw ScriptError(Object::binary_error(op));
+
+    return std::move(operands.left);
+}
+
+Object Runtime::negate(Object value)
+{
+    if (!value.try_negate())
+        throw ScriptError("Unable to negate object!");
+
+    return value;
+}
+
+/**
+ * Parses a number the optimizer could not, which fails just like it did.
+*/
+Object Runtime::parse_number(const char* number)
+{
+    std::string value = number;
+
+    try
+    {
+        if (value.find('.') != std::string::npos)
+            return Object::make_float32(std::stof(value));
+
+        return Object::make_int32(std::stoi(value));
+    }
+    catch (const std::exception& exp)
+    {
+        throw ScriptError(exp.what());
+    }
+}
+
+/**
+ * Builds a float that has no literal, like infinity or a nan.
+*/
+float Runtime::float_from_bits(unsigned int bits)
+{
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Runs the emitted top level block on a stack of the given size.
+ * Deep recursion ends the script, at the recursion limit or before
+ * the stack runs out, whichever comes first.
+*/
+void Runtime::run_script(void (*script)(), std::size_t stackSize)
+{
+    char here;
+    stackEnd = reinterpret_cast<std::uintptr_t>(&here) - (stackSize - STACK_MARGIN);
+
+    try
+    {
+        script();
+    }
+    catch (const EmittedRecursionLimit& limit)
+    {
+        report("Maximum recursion depth exceeded!", limit.call->lineColumn, limit.call->lineNumber);
+    }
+}
+
+/**
+ * Runs the emitted top level block and shows the diagnostics.
+*/
+int Runtime::run(void (*script)())
+{
+    stack.reset();
+
+#ifndef _WIN32
+    struct Start
+    {
+        Runtime* runtime;
+        void (*script)();
+
+        static void* run(void* start)
+        {
+            Start* self = static_cast<Start*>(start);
+            self->runtime->run_script(self->script, SCRIPT_STACK_SIZE);
+            return nullptr;
+        }
+    };
+
+    Start start = { this, script };
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+
+    bool started = pthread_attr_setstacksize(&attributes, SCRIPT_STACK_SIZE) == 0
+        && pthread_create(&thread, &attributes, &Start::run, &start) == 0;
+
+    pthread_attr_destroy(&attributes);
+
+    // without a thread the script makes do with the stack of main
+    if (started)
+        pthread_join(thread, nullptr);
+    else
+        run_script(script, DEFAULT_STACK_SIZE);
+#else
+    run_script(script, DEFAULT_STACK_SIZE);
+#endif
+
+    if (diagnostics.has_errors() || diagnostics.has_warnings())
+        diagnostics.dump();
+
+    return 0;
+}
+
+#pragma endregion
@@ -0,0 +1,152 @@
+#ifndef RUNTIME
+#define RUNTIME
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstring>
+#include <limits>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+
+#include "file.hpp"
+#include "diagnostics.hpp"
+#include "symbols.hpp"
+#include "parser.hpp"
+#include "object.hpp"
+#include "natives.hpp"
+#include "runner.hpp"
+
+namespace pop
+{
+    /**
+     * The C++ function a user function was emitted as.
+    */
+    typedef Object (*EmittedBody)();
+
+    /**
+     * A user function of an emitted script. The stack finds it
+     * like any other function and the call runs its body.
+    */
+    struct SI_Emitted : public SI_Function
+    {
+        EmittedBody body;
+    };
+
+    /**
+     * A user function call site of an emitted script, remembering the
+     * function it found last and the function epoch it found it in.
+    */
+    struct EmittedCall
+    {
+        Symbol functionName;
+        unsigned int argumentCount;
+        unsigned int lineColumn;
+        unsigned int lineNumber;
+        Statement* callee = nullptr;
+        unsigned int calleeEpoch = 0;
+    };
+
+    /**
+     * Thrown by a call nested deeper than the recursion limit,
+     * it ends the whole script.
+    */
+    struct EmittedRecursionLimit
+    {
+        const EmittedCall* call;
+    };
+
+    /**
+     * An error an expression escapes with. The statement or native
+     * call it escapes from reports it at its own location.
+    */
+    struct ScriptError : public std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * The operands of a binary operator, evaluated left to right.
+    */
+    struct Operands
+    {
+        Object left;
+        Object right;
+    };
+
+    /**
+     * Enters a block for as long as it is in scope.
+    */
+    struct BlockScope
+    {
+        Stack& stack;
+
+        BlockScope(Stack& stack, Statement& block) : stack(stack) { stack.enter_block(block); }
+        ~BlockScope() { stack.exit_block(); }
+    };
+
+    /**
+     * Gives a loop a new stamp for as long as it is in scope
+     * and the enclosing run of the same loop its stamp back.
+    */
+    struct LoopStamp
+    {
+        unsigned int& stamp;
+        unsigned int enclosingStamp;
+
+        LoopStamp(unsigned int& stamp, unsigned int& lastStamp) : stamp(stamp), enclosingStamp(stamp) { stamp = ++lastStamp; }
+        ~LoopStamp() { stamp = enclosingStamp; }
+    };
+
+    /**
+     * Everything a script emitted as C++ by the Emitter needs while it
+     * runs. The emitted code keeps its variables and functions on the
+     * same stack as the runner and reports errors the same way, so it
+     * behaves exactly like the tree it was emitted from.
+    */
+    class Runtime
+    {
+        std::deque<Statement> statements;
+        std::vector<std::unique_ptr<StatementInfo>> infos;
+        File file;
+        const SI_Emitted* tailCall;
+        std::vector<Object> tailArguments;
+        unsigned int callDepth;
+        std::uintptr_t stackEnd;    // calls below it would overflow the C++ stack
+
+        void run_script(void (*script)(), std::size_t stackSize);
+
+    public:
+        Stack stack;
+        Diagnostics diagnostics;
+        bool hasErrors;
+        unsigned int lastLoopStamp;
+
+        Runtime();
+        Runtime(const Runtime&) = delete;
+        Runtime& operator=(const Runtime&) = delete;
+
+        void add_line(const char* line);
+        Statement* add_function(const char* name, std::initializer_list<const char*> parameterNames, EmittedBody body);
+        Statement* add_block(std::initializer_list<Statement*> functions);
+        Symbol intern(const char* name);
+        unsigned int find_native(const char* name);
+
+        void report(const std::string& message, unsigned int lineColumn, unsigned int lineNumber);
+        Object call_native(unsigned int native, Object* arguments, unsigned int lineColumn, unsigned int lineNumber);
+        SI_Emitted* find_function(EmittedCall& call);
+        Object invoke(const SI_Emitted& function, unsigned int frameBase, const EmittedCall& call);
+        Object tail_call(const SI_Emitted& function, std::initializer_list<Object> arguments);
+
+        static Object apply(BinaryOp op, Operands operands);
+        static Object negate(Object value);
+        static Object parse_number(const char* number);
+        static float float_from_bits(unsigned int bits);
+
+        int run(void (*script)());
+    };
+}
+
+#endif
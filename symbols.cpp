@@ -0,0 +1,46 @@
+#include "symbols.hpp"
+
+using namespace pop;
+
+#pragma region Public Methods
+
+/**
+ * The symbol table shared by the tokenizer, parser and runtime.
+*/
+SymbolTable& SymbolTable::global()
+{
+    static SymbolTable table;
+    return table;
+}
+
+/**
+ * Gets the symbol of a name, adding the name if it is new.
+*/
+Symbol SymbolTable::intern(std::string_view name)
+{
+    auto found = ids.find(name);
+
+    if (found != ids.end())
+        return found->second;
+
+    Symbol symbol = names.size();
+    names.emplace_back(name);
+    ids.emplace(names.back(), symbol);
+
+    return symbol;
+}
+
+/**
+ * Gets the name a symbol was interned from.
+*/
+const std::string& SymbolTable::get_name(Symbol symbol) const
+{
+    static const std::string noName = "";
+
+    if (symbol >= names.size())
+        return noName;
+
+    return names[symbol];
+}
+
+#pragma endregion
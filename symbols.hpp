@@ -0,0 +1,38 @@
+#ifndef SYMBOLS
+#define SYMBOLS
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+
+namespace pop
+{
+    /**
+     * An interned identifier. Two names are the
+     * same exactly when their symbols are the same.
+    */
+    typedef unsigned int Symbol;
+
+    const Symbol NO_SYMBOL = 0xFFFFFFFF;
+
+    /**
+     * Hands out one symbol per distinct identifier.
+     * There is a single table for the whole program.
+    */
+    class SymbolTable
+    {
+        std::unordered_map<std::string_view, Symbol> ids; // keys view into names
+        std::deque<std::string> names;
+
+        SymbolTable() { }
+
+    public:
+        static SymbolTable& global();
+
+        Symbol intern(std::string_view name);
+        const std::string& get_name(Symbol symbol) const;
+    };
+}
+
+#endif
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Runs every script in tests and compares what it prints with the
+# .out file next to it. Each script runs walking the tree and tiering
+# up (the default), only walking the tree (-hot0), on the virtual
+# machine with and without the JIT, and unoptimized. Scripts are also
+# fed through a pipe, which can't be mapped or seeked and has to be
+# read until it ends. deep_recursion is also written out as C++ and
+# built, its calls nest on the C++ stack. depth_limit makes 70 calls
+# deep, which -depth70 allows and -depth69 stops on every engine.
+
+cd "$(dirname "$0")"
+pop=../pop
+failed=0
+
+check()
+{
+    if ! diff -u "$2" "$3" > /dev/null; then
+        echo "FAIL $1"
+        diff -u "$2" "$3" | head -20
+        failed=1
+    fi
+}
+
+for script in *.pop; do
+    name=${script%.pop}
+
+    for flags in "" "-hot0" "-vm" "-vm -nojit" "-O0"; do
+        $pop "$script" $flags > "$name.got" 2>&1
+        check "$script $flags" "$name.out" "$name.got"
+    done
+
+    cat "$script" | $pop /dev/stdin > "$name.got" 2>&1
+    check "$script (pipe)" "$name.out" "$name.got"
+    rm -f "$name.got"
+done
+
+for flags in "" "-hot0" "-vm" "-vm -nojit" "-O0"; do
+    $pop depth_limit.pop -depth70 $flags > depth_limit.got 2>&1
+    check "depth_limit.pop -depth70 $flags" depth_limit.out depth_limit.got
+    $pop depth_limit.pop -depth69 $flags > depth_limit.got 2>&1
+    check "depth_limit.pop -depth69 $flags" depth_limit_69.out depth_limit.got
+done
+
+rm -f depth_limit.got
+
+$pop deep_recursion.pop --emit-cpp
+make -s -C .. tests/deep_recursion.pop.exe > /dev/null
+./deep_recursion.pop.exe > deep_recursion.got 2>&1
+check "deep_recursion.pop (--emit-cpp)" deep_recursion.out deep_recursion.got
+rm -f deep_recursion.got deep_recursion.pop.cpp deep_recursion.pop.exe
+
+[ $failed = 0 ] && echo "All tests passed."
+exit $failed
@@ -4,14 +4,15 @@ using namespace pop;
 
 #pragma region Token
 
-Token::Token(std::string value,
+Token::Token(std::string_view value,
     TokenType type,
-    std::string line,
+    std::string_view line,
     unsigned int lineColumn,
     unsigned int lineNumber)
 {
     this->value = value;
     this->type = type;
+    this->symbol = NO_SYMBOL;
     this->line = line;
     this->lineColumn = lineColumn;
     this->lineNumber = lineNumber;
@@ -129,15 +130,14 @@ void Tokenizer::parse_token()
     // PARSE STRING
     else if (get() == '"')
     {
-        std::string value = EMPTY_STRING;
-
         ++lineColumn;
 
+        unsigned int start = lineColumn;
+
         while (!eol() && get() != '"')
-        {
-            value += get();
             ++lineColumn;
-        }
+
+        std::string_view value = currentLine.substr(start, lineColumn - start);
 
         if (get() != '"')
             diagnostics->add_error("Missing \"!", currentLine, lineColumn, lineNumber);
@@ -147,13 +147,12 @@ void Tokenizer::parse_token()
     // PARSE WORD
     else if (isalpha(get()) || get() == '_')
     {
-        std::string value = EMPTY_STRING;
+        unsigned int start = lineColumn;
 
         while (!eol() && (isalnum(get()) || get() == '_'))
-        {
-            value += get();
             ++lineColumn;
-        }
+
+        std::string_view value = currentLine.substr(start, lineColumn - start);
 
         --lineColumn;
 
@@ -198,12 +197,13 @@ void Tokenizer::parse_token()
         else
         {
             tokens.push_back(Token(value, TokenType::WORD, currentLine, lineColumn, lineNumber));
+            tokens.back().symbol = SymbolTable::global().intern(value);
         }
     }
     // PARSE NUMBER
     else if (isdigit(get()) || (get() == '.' && isdigit(next())))
     {
-        std::string value = EMPTY_STRING;
+        unsigned int start = lineColumn;
         bool hasDecimalPoint = false;
 
         while (!eol() && (isdigit(get()) || get() == '.'))
@@ -213,10 +213,11 @@ void Tokenizer::parse_token()
             else if (get() == '.')
                 hasDecimalPoint = true;
 
-            value += get();
             ++lineColumn;
         }
 
+        std::string_view value = currentLine.substr(start, lineColumn - start);
+
         --lineColumn;
 
         tokens.push_back(Token(value, TokenType::NUMBER, currentLine, lineColumn, lineNumber));
@@ -225,13 +226,13 @@ void Tokenizer::parse_token()
     else if (get() == '\'')
     {
         ++lineColumn;
-        char value = get();
+        std::string_view value = currentLine.substr(std::min<size_t>(lineColumn, currentLine.size()), 1);
         ++lineColumn;
 
         if (get() != '\'')
             diagnostics->add_error("Missing closing single quotes!", currentLine, lineColumn, lineNumber);
         
-        tokens.push_back(Token(std::string(1, value), TokenType::CHAR, currentLine, lineColumn, lineNumber));
+        tokens.push_back(Token(value, TokenType::CHAR, currentLine, lineColumn, lineNumber));
     }
     // TWO CHARACTER OPERATORS
     else if (get() == '=' && next() == '=')
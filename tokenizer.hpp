@@ -2,11 +2,13 @@
 #define TOKENIZER
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 
 #include "file.hpp"
 #include "diagnostics.hpp"
+#include "symbols.hpp"
 
 const std::string EMPTY_STRING = "";
 
@@ -55,18 +57,21 @@ namespace pop
 
     /**
      * The data structure for holding a token.
+     * The value and the line are views into the
+     * source buffer of the File being tokenized.
     */
     struct Token
     {
-        std::string value;
+        std::string_view value;
         TokenType type;
-        std::string line;
+        Symbol symbol; // only set for words
+        std::string_view line;
         unsigned int lineColumn;
         unsigned int lineNumber;
 
-        Token(std::string value,
+        Token(std::string_view value,
             TokenType type,
-            std::string line,
+            std::string_view line,
             unsigned int lineColumn,
             unsigned int lineNumber);
 
@@ -81,7 +86,7 @@ namespace pop
         std::vector<Token> tokens;
         File* file;
         Diagnostics* diagnostics;
-        std::string currentLine;
+        std::string_view currentLine;
         unsigned int lineColumn;
         unsigned int lineNumber;
         bool skipLine; // flag is raised whenever a line should be skipped
@@ -0,0 +1,416 @@
+#include "typechecker.hpp"
+
+using namespace pop;
+
+#pragma region Helpers
+
+static StaticType static_type(ObjectType type)
+{
+    switch (type)
+    {
+    case ObjectType::INT32: return StaticType::INT32;
+    case ObjectType::FLOAT32: return StaticType::FLOAT32;
+    case ObjectType::CHAR: return StaticType::CHAR;
+    case ObjectType::NIL: return StaticType::NIL;
+    case ObjectType::BOOL: return StaticType::BOOL;
+    case ObjectType::STRING: return StaticType::STRING;
+    }
+
+    return StaticType::UNKNOWN;
+}
+
+static ObjectType object_type(StaticType type)
+{
+    switch (type)
+    {
+    case StaticType::INT32: return ObjectType::INT32;
+    case StaticType::FLOAT32: return ObjectType::FLOAT32;
+    case StaticType::CHAR: return ObjectType::CHAR;
+    case StaticType::BOOL: return ObjectType::BOOL;
+    case StaticType::STRING: return ObjectType::STRING;
+    default: return ObjectType::NIL;
+    }
+}
+
+/**
+ * If an expression cannot fail, every operator in it has proven operand types.
+*/
+static bool is_proven(const Statement& expression)
+{
+    if (is_binary_operator(expression.type))
+    {
+        std::vector<const Statement*> chain;
+
+        if (!is_proven(collect_operator_chain(expression, chain)))
+            return false;
+
+        for (auto op : chain)
+        {
+            if (op->specialization != Specialization::TYPED_INT32 &&
+                op->specialization != Specialization::TYPED_FLOAT32 &&
+                op->specialization != Specialization::TYPED_STRING)
+                return false;
+
+            if (!is_proven(op->children()[1]))
+                return false;
+        }
+
+        return true;
+    }
+
+    switch (expression.type)
+    {
+    case StatementType::CONSTANT:
+    case StatementType::STRING:
+    case StatementType::CHAR:
+    case StatementType::BOOLEAN:
+    case StatementType::VARIABLE:
+        return true;
+    case StatementType::EXP:
+    case StatementType::INVARIANT:
+        return is_proven(expression.children()[0]);
+    default:
+        return false;
+    }
+}
+
+#pragma endregion
+
+#pragma region Private Methods
+
+/**
+ * What is known about a value that is one of two types.
+*/
+StaticType TypeChecker::join(StaticType a, StaticType b)
+{
+    if (a == StaticType::NONE)
+        return b;
+
+    if (b == StaticType::NONE || a == b)
+        return a;
+
+    return StaticType::UNKNOWN;
+}
+
+void TypeChecker::join(TypeState& state, const TypeState& other)
+{
+    if (state.size() < other.size())
+        state.resize(other.size(), StaticType::NONE);
+
+    for (unsigned int i = 0; i < other.size(); ++i)
+        state[i] = join(state[i], other[i]);
+}
+
+/**
+ * Warns about a statement once, and only on the final pass over it.
+*/
+void TypeChecker::warn(const std::string& message, const Statement& statement)
+{
+    if (!final || inlineDepth > 0 || !warned.insert(&statement).second)
+        return;
+
+    diagnostics->add_warning(message, statement.lineColumn, statement.lineNumber);
+}
+
+/**
+ * Finds the name of every variable a function sets by name.
+*/
+void TypeChecker::collect_names_set_by_name(const Statement& statement)
+{
+    if (statement.type == StatementType::ASSIGN && static_cast<SI_Variable*>(statement.info)->byName)
+        namesSetByName.insert(static_cast<SI_Variable*>(statement.info)->symbol);
+
+    if (is_binary_operator(statement.type))
+    {
+        std::vector<const Statement*> chain;
+        collect_names_set_by_name(collect_operator_chain(statement, chain));
+
+        for (auto op : chain)
+            collect_names_set_by_name(op->children()[1]);
+
+        return;
+    }
+
+    for (auto& child : statement.children())
+        collect_names_set_by_name(child);
+}
+
+/**
+ * Checks a function body in a frame of its own. Nothing
+ * is known about the arguments it will be called with.
+*/
+void TypeChecker::check_function(Statement& function)
+{
+    SI_Function* siFunction = static_cast<SI_Function*>(function.info);
+    TypeState state(siFunction->parameterNames.size(), StaticType::UNKNOWN);
+
+    std::vector<bool> enclosingSlots;
+    enclosingSlots.swap(slotsSetByCalls);
+    check_block(function.children()[0], state);
+    slotsSetByCalls.swap(enclosingSlots);
+}
+
+/**
+ * Checks a block. Its variables are gone once it ends.
+*/
+void TypeChecker::check_block(Statement& block, TypeState& state)
+{
+    SI_Block* siBlock = static_cast<SI_Block*>(block.info);
+    TypeState exit = state;
+
+    for (auto& statement : block.children())
+    {
+        check_statement(statement, state);
+        join(exit, state);
+    }
+
+    if (exit.size() > siBlock->offset)
+        exit.resize(siBlock->offset);
+
+    state.swap(exit);
+}
+
+void TypeChecker::check_statement(Statement& statement, TypeState& state)
+{
+    switch (statement.type)
+    {
+    case StatementType::ASSIGN:
+        {
+            SI_Variable* siAssign = static_cast<SI_Variable*>(statement.info);
+            StaticType type = check_expression(statement.children()[0], state);
+
+            // a variable set by name is only ever read by name
+            if (siAssign->slot >= 0 && !siAssign->byName)
+            {
+                if (state.size() <= CAST(siAssign->slot, unsigned int))
+                    state.resize(siAssign->slot + 1, StaticType::NONE);
+
+                state[siAssign->slot] = type;
+
+                // a function can set it by name in any call
+                if (namesSetByName.count(siAssign->symbol) > 0)
+                {
+                    if (slotsSetByCalls.size() <= CAST(siAssign->slot, unsigned int))
+                        slotsSetByCalls.resize(siAssign->slot + 1, false);
+
+                    slotsSetByCalls[siAssign->slot] = true;
+                }
+            }
+        }
+        break;
+    case StatementType::IF:
+        {
+            check_expression(statement.children()[0], state);
+
+            TypeState thenState = state;
+            check_block(statement.children()[1], thenState);
+
+            if (statement.children().size() == 3)
+                check_statement(statement.children()[2], state);
+
+            join(state, thenState);
+        }
+        break;
+    case StatementType::ELSE:
+        check_block(statement.children()[0], state);
+        break;
+    case StatementType::WHILE:
+        check_while(statement, state);
+        break;
+    case StatementType::FUNCTION:
+        if (final)
+            check_function(statement);
+        break;
+    case StatementType::FUNCTION_CALL:
+        check_expression(statement, state);
+        break;
+    case StatementType::RETURN:
+        check_expression(statement.children()[0], state);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Checks a loop. The body is checked again with what can enter it until
+ * that stops changing, and only that last check warns and marks operators.
+*/
+void TypeChecker::check_while(Statement& whileStmt, TypeState& state)
+{
+    bool wasFinal = final;
+    TypeState head = state;
+
+    final = false;
+
+    while (true)
+    {
+        TypeState body = head;
+        check_expression(whileStmt.children()[0], body);
+        check_block(whileStmt.children()[1], body);
+
+        TypeState next = head;
+        join(next, body);
+
+        if (next == head)
+            break;
+
+        head.swap(next);
+    }
+
+    final = wasFinal;
+
+    if (final)
+    {
+        TypeState body = head;
+        check_expression(whileStmt.children()[0], body);
+        check_block(whileStmt.children()[1], body);
+    }
+
+    state.swap(head);
+}
+
+StaticType TypeChecker::check_expression(Statement& expression, TypeState& state)
+{
+    if (is_binary_operator(expression.type))
+    {
+        // a chain of operators is checked from its first operand up
+        std::vector<Statement*> chain;
+        StaticType left = check_expression(collect_operator_chain(expression, chain), state);
+
+        for (auto op = chain.rbegin(); op != chain.rend(); ++op)
+        {
+            StaticType right = check_expression((*op)->children()[1], state);
+            left = check_operator(**op, binary_op_of((*op)->type), left, right);
+        }
+
+        return left;
+    }
+
+    switch (expression.type)
+    {
+    case StatementType::CONSTANT:
+        return static_type(static_cast<SI_Constant*>(expression.info)->value.type);
+    case StatementType::STRING:
+        return StaticType::STRING;
+    case StatementType::CHAR:
+        return StaticType::CHAR;
+    case StatementType::BOOLEAN:
+        return StaticType::BOOL;
+    case StatementType::VARIABLE:
+        {
+            int slot = static_cast<SI_Variable*>(expression.info)->slot;
+
+            if (slot < 0 || CAST(slot, unsigned int) >= state.size() || state[slot] == StaticType::NONE)
+                return StaticType::UNKNOWN;
+
+            return state[slot];
+        }
+    case StatementType::EXP:
+    case StatementType::INVARIANT:
+        return check_expression(expression.children()[0], state);
+    case StatementType::INLINE:
+        {
+            // an inlined function that fails evaluates to nil, its
+            // warnings are left to the function itself like for a call
+            ++inlineDepth;
+            StaticType type = check_expression(expression.children()[0], state);
+            --inlineDepth;
+            return is_proven(expression.children()[0]) ? type : StaticType::UNKNOWN;
+        }
+    case StatementType::NEGATE_OP:
+        switch (check_expression(expression.children()[0], state))
+        {
+        case StaticType::INT32:
+        case StaticType::CHAR:
+        case StaticType::BOOL:
+            return StaticType::INT32;
+        case StaticType::FLOAT32:
+            return StaticType::FLOAT32;
+        case StaticType::NIL:
+        case StaticType::STRING:
+            warn("Unable to negate object!", expression);
+            return StaticType::UNKNOWN;
+        default:
+            return StaticType::UNKNOWN;
+        }
+    case StatementType::FUNCTION_CALL:
+        // user functions return anything, natives nil when they fail
+        for (auto& argument : expression.children())
+            check_expression(argument, state);
+
+        // the callee can set the variables of its callers by name
+        if (static_cast<SI_FunctionCall*>(expression.info)->native < 0)
+        {
+            for (unsigned int i = 0; i < state.size() && i < slotsSetByCalls.size(); ++i)
+            {
+                if (slotsSetByCalls[i] && state[i] != StaticType::NONE)
+                    state[i] = StaticType::UNKNOWN;
+            }
+        }
+
+        return StaticType::UNKNOWN;
+    default:
+        return StaticType::UNKNOWN;
+    }
+}
+
+/**
+ * Checks a binary operator on operands of the given types. An operator
+ * only gives a value when both operands have the same type, so knowing
+ * one of them is enough to know the result.
+*/
+StaticType TypeChecker::check_operator(Statement& statement, BinaryOp op, StaticType left, StaticType right)
+{
+    StaticType known = left != StaticType::UNKNOWN ? left : right;
+
+    if (known == StaticType::UNKNOWN)
+        return op >= BinaryOp::EQUALS ? StaticType::BOOL : StaticType::UNKNOWN;
+
+    bool mismatch = left != StaticType::UNKNOWN && right != StaticType::UNKNOWN && left != right;
+
+    if (mismatch || !binary_supports(op, object_type(known)))
+    {
+        warn(Object::binary_error(op), statement);
+        return StaticType::UNKNOWN;
+    }
+
+    // both operands are proven, the runner does not need to check them
+    if (final && left == right)
+    {
+        if (known == StaticType::INT32)
+            statement.specialization = Specialization::TYPED_INT32;
+        else if (known == StaticType::FLOAT32)
+            statement.specialization = Specialization::TYPED_FLOAT32;
+        else if (known == StaticType::STRING)
+            statement.specialization = Specialization::TYPED_STRING;
+    }
+
+    if (op >= BinaryOp::EQUALS)
+        return StaticType::BOOL;
+
+    if (known == StaticType::CHAR || known == StaticType::BOOL)
+        return StaticType::INT32;
+
+    return known;
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+void TypeChecker::check(Statement* root, Diagnostics* diagnostics)
+{
+    this->diagnostics = diagnostics;
+    warned.clear();
+    namesSetByName.clear();
+    slotsSetByCalls.clear();
+    final = true;
+    inlineDepth = 0;
+    collect_names_set_by_name(*root);
+
+    TypeState state;
+    check_block(*root, state);
+}
+
+#pragma endregion
@@ -0,0 +1,74 @@
+#ifndef TYPECHECKER
+#define TYPECHECKER
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+#include "parser.hpp"
+#include "object.hpp"
+#include "diagnostics.hpp"
+
+namespace pop
+{
+    /**
+     * What is known about the type of a value before the script runs.
+     * NONE is a slot that holds no variable yet, UNKNOWN can be anything.
+    */
+    enum class StaticType : char
+    {
+        NONE,
+        INT32,
+        FLOAT32,
+        CHAR,
+        NIL,
+        BOOL,
+        STRING,
+        UNKNOWN
+    };
+
+    /**
+     * Infers the types of the variables in every frame slot as the
+     * statements run, warns about operators that fail whenever they
+     * are reached, and marks operators whose operand types are proven
+     * so the runner can skip checking them.
+     *
+     * A block can stop after any statement once an error is reported,
+     * so what leaves a block is everything seen at any point inside it,
+     * and a loop is run over until what enters its body stops changing.
+     * Only variables with a slot are tracked. A function can set the
+     * variables of its callers by name, so the ones it does are unknown
+     * after a call. Calls are unknown, a native that fails evaluates to
+     * nil and so does an inlined function, unless its operators are all
+     * proven.
+    */
+    class TypeChecker
+    {
+        typedef std::vector<StaticType> TypeState;
+
+        Diagnostics* diagnostics;
+        std::unordered_set<const Statement*> warned;
+        std::unordered_set<Symbol> namesSetByName;
+        std::vector<bool> slotsSetByCalls;    // of the frame being checked
+        bool final;
+        unsigned int inlineDepth;
+
+        static StaticType join(StaticType a, StaticType b);
+        static void join(TypeState& state, const TypeState& other);
+
+        void warn(const std::string& message, const Statement& statement);
+        void collect_names_set_by_name(const Statement& statement);
+
+        void check_function(Statement& function);
+        void check_block(Statement& block, TypeState& state);
+        void check_statement(Statement& statement, TypeState& state);
+        void check_while(Statement& whileStmt, TypeState& state);
+        StaticType check_expression(Statement& expression, TypeState& state);
+        StaticType check_operator(Statement& statement, BinaryOp op, StaticType left, StaticType right);
+
+    public:
+        void check(Statement* root, Diagnostics* diagnostics);
+    };
+}
+
+#endif
@@ -0,0 +1,645 @@
+#include "vm.hpp"
+
+using namespace pop;
+
+// GCC and Clang can jump straight to the next handler
+#if defined(__GNUC__)
+#define COMPUTED_GOTO
+#endif
+
+#ifdef COMPUTED_GOTO
+#define VM_CASE(op) op_##op:
+#define VM_NEXT() instruction = ip++; goto *dispatchTable[CAST(instruction->op, int)]
+#else
+#define VM_CASE(op) case OpCode::op:
+#define VM_NEXT() continue
+#endif
+
+#define VM_BINARY(op, symbol) \
+    VM_CASE(op) \
+    { \
+        Object& left = regs[instruction->a]; \
+        if (instruction->a != instruction->b) \
+            left = regs[instruction->b]; \
+        left symbol regs[instruction->c]; \
+    } \
+    VM_NEXT();
+
+#pragma region Private Methods
+
+/**
+ * The dispatch loop of the virtual machine.
+*/
+void VirtualMachine::execute(unsigned int chunkIndex)
+{
+#ifdef COMPUTED_GOTO
+    // must follow the order of OpCode
+    static void* dispatchTable[] = {
+        &&op_LOAD_CONST, &&op_LOAD_NIL, &&op_GET_VAR, &&op_GET_LOCAL, &&op_SET_LOCAL, &&op_DECLARE, &&op_SET_VAR,
+        &&op_ADD, &&op_SUB, &&op_MULT, &&op_DIV, &&op_MOD,
+        &&op_EQUALS, &&op_NEQUALS, &&op_GTHANE, &&op_LTHANE, &&op_GTHAN, &&op_LTHAN,
+        &&op_NEGATE, &&op_CALL_NATIVE, &&op_CALL_PREPARE, &&op_INVOKE, &&op_TAIL_INVOKE, &&op_RETURN, &&op_RETURN_NIL,
+        &&op_JUMP, &&op_JUMP_IF_FALSE, &&op_JUMP_IF_ERROR,
+        &&op_ENTER_SCOPE, &&op_LEAVE_SCOPE, &&op_ENTER_LOOP, &&op_LEAVE_LOOP, &&op_LOAD_INVARIANT, &&op_STORE_INVARIANT,
+        &&op_RAISE, &&op_HALT
+    };
+#endif
+
+    const Chunk* chunk = &program->chunks[chunkIndex];
+    const Instruction* ip = chunk->code.data();
+    const Instruction* instruction = ip;
+    unsigned int base = 0;
+    Object* regs = registers.data();
+    const NativeTable& natives = NativeTable::global();
+
+    while (true)
+    {
+        try
+        {
+#ifdef COMPUTED_GOTO
+            VM_NEXT();
+#else
+            for (;;)
+            {
+            instruction = ip++;
+
+            switch (instruction->op)
+            {
+#endif
+            VM_CASE(LOAD_CONST)
+            {
+                regs[instruction->a] = chunk->constants[instruction->bx()];
+            }
+            VM_NEXT();
+
+            VM_CASE(LOAD_NIL)
+            {
+                regs[instruction->a] = Object();
+            }
+            VM_NEXT();
+
+            VM_CASE(GET_VAR)
+            {
+                regs[instruction->a] = stack.get_variable(chunk->names[instruction->bx()]);
+            }
+            VM_NEXT();
+
+            VM_CASE(GET_LOCAL)
+            {
+                regs[instruction->a] = stack.local(instruction->bx());
+            }
+            VM_NEXT();
+
+            VM_CASE(SET_LOCAL)
+            {
+                stack.local(instruction->bx()) = regs[instruction->a];
+            }
+            VM_NEXT();
+
+            VM_CASE(DECLARE)
+            {
+                const Declaration& declaration = chunk->declarations[instruction->bx()];
+                stack.declare_variable(declaration.slot, declaration.name, regs[instruction->a]);
+            }
+            VM_NEXT();
+
+            VM_CASE(SET_VAR)
+            {
+                const Declaration& declaration = chunk->declarations[instruction->bx()];
+
+                if (!stack.set_variable(declaration.name, regs[instruction->a]))
+                    stack.declare_variable(declaration.slot, declaration.name, regs[instruction->a]);
+            }
+            VM_NEXT();
+
+            VM_BINARY(ADD, +)
+            VM_BINARY(SUB, -)
+            VM_BINARY(MULT, *)
+            VM_BINARY(DIV, /)
+            VM_BINARY(MOD, %)
+            VM_BINARY(EQUALS, ==)
+            VM_BINARY(NEQUALS, !=)
+            VM_BINARY(GTHANE, >=)
+            VM_BINARY(LTHANE, <=)
+            VM_BINARY(GTHAN, >)
+            VM_BINARY(LTHAN, <)
+
+            VM_CASE(NEGATE)
+            {
+                Object& value = regs[instruction->a];
+                if (instruction->a != instruction->b)
+                    value = regs[instruction->b];
+                -value;
+            }
+            VM_NEXT();
+
+            VM_CASE(CALL_NATIVE)
+            {
+                regs[instruction->a] = natives.get_native(instruction->c).function(regs + instruction->b);
+            }
+            VM_NEXT();
+
+            VM_CASE(CALL_PREPARE)
+            {
+                const CallSite& call = chunk->calls[instruction->bx()];
+
+                // the same functions can be called as last time
+                if (call.callee >= 0 && call.calleeEpoch == stack.get_function_epoch())
+                {
+                    // the callee rides in the result register until INVOKE
+                    regs[instruction->a] = Object::make_int32(call.callee);
+                    VM_NEXT();
+                }
+
+                Statement* function = stack.get_function_in_block(call.functionName);
+
+                if (function == nullptr)
+                {
+                    report("The function with the name " + SymbolTable::global().get_name(call.functionName) + " has not been defined!", *call.statement);
+                    regs[instruction->a] = Object();
+                    ip = chunk->code.data() + call.skip;
+                }
+                else if (static_cast<SI_Function*>(function->info)->parameterNames.size() != call.argumentCount)
+                {
+                    report("Inccorect number of parameters!", *call.statement);
+                    regs[instruction->a] = Object();
+                    ip = chunk->code.data() + call.skip;
+                }
+                else
+                {
+                    call.callee = program->functions[function];
+                    call.calleeEpoch = stack.get_function_epoch();
+                    regs[instruction->a] = Object::make_int32(call.callee);
+                }
+            }
+            VM_NEXT();
+
+            VM_CASE(INVOKE)
+            {
+                if (frames.size() >= depthLimit)
+                    throw RecursionLimit{ find_call(*chunk, instruction) };
+
+                const Chunk* callee = &program->chunks[regs[instruction->a].int32Value];
+
+                CallFrame frame;
+                frame.memoized = nullptr;
+
+                // a memoized function called with the same arguments as before
+                if (callee->memoized && memo.enabled() && !hasErrors && MemoCache::pays_off(*static_cast<SI_Function*>(callee->function->info)))
+                {
+                    if (const Object* result = memo.find(callee->function, regs + instruction->b, instruction->c))
+                    {
+                        regs[instruction->a] = *result;
+
+                        if (jitEnabled)
+                            ip = run_compiled(*chunk, ip, regs, instruction);
+
+                        VM_NEXT();
+                    }
+
+                    frame.memoized = callee;
+                    frame.memoBase = memoArguments.size();
+                    memoArguments.insert(memoArguments.end(), regs + instruction->b, regs + instruction->b + instruction->c);
+                }
+
+                frame.chunk = chunk;
+                frame.ip = ip;
+                frame.base = base;
+                frame.returnRegister = base + instruction->a;
+                frame.blockDepth = stack.get_block_depth();
+
+                unsigned int frameBase = stack.get_top();
+
+                for (unsigned int i = 0; i < instruction->c; ++i)
+                    stack.push_argument(regs[instruction->b + i]);
+
+                frame.stackBase = stack.enter_frame(frameBase, callee->parameterNames);
+                frames.push_back(frame);
+
+                base += chunk->registerCount;
+
+                if (registers.size() < base + callee->registerCount)
+                    registers.resize(base + callee->registerCount);
+
+                chunk = callee;
+                ip = callee->code.data();
+                regs = registers.data() + base;
+
+                if (jitEnabled)
+                    ip = run_compiled(*chunk, ip, regs, instruction);
+            }
+            VM_NEXT();
+
+            VM_CASE(TAIL_INVOKE)
+            {
+                const Chunk* callee = &program->chunks[regs[instruction->a].int32Value];
+                const CallFrame& frame = frames.back();
+
+                // the current function is done, the callee gets its
+                // frame and registers and returns to its caller
+                while (stack.get_block_depth() > frame.blockDepth)
+                    stack.exit_block();
+
+                stack.exit_frame(frame.stackBase);
+                leave_loops(frames.size());
+
+                unsigned int frameBase = stack.get_top();
+
+                for (unsigned int i = 0; i < instruction->c; ++i)
+                    stack.push_argument(regs[instruction->b + i]);
+
+                stack.enter_frame(frameBase, callee->parameterNames);
+
+                if (registers.size() < base + callee->registerCount)
+                    registers.resize(base + callee->registerCount);
+
+                chunk = callee;
+                ip = callee->code.data();
+                regs = registers.data() + base;
+
+                if (jitEnabled)
+                    ip = run_compiled(*chunk, ip, regs, instruction);
+            }
+            VM_NEXT();
+
+            VM_CASE(RETURN)
+            {
+                Object value = regs[instruction->a];
+
+                // a loop chunk returning from the walked function it runs in
+                if (frames.empty())
+                {
+                    while (stack.get_block_depth() > entryBlockDepth)
+                        stack.exit_block();
+
+                    registers[0] = value;
+                    returned = true;
+                    return;
+                }
+
+                const CallFrame& frame = frames.back();
+
+                if (frame.memoized != nullptr)
+                    remember(frame, value);
+
+                while (stack.get_block_depth() > frame.blockDepth)
+                    stack.exit_block();
+
+                stack.exit_frame(frame.stackBase);
+                leave_loops(frames.size());
+
+                chunk = frame.chunk;
+                ip = frame.ip;
+                base = frame.base;
+                regs = registers.data() + base;
+                registers[frame.returnRegister] = value;
+
+                frames.pop_back();
+
+                if (jitEnabled)
+                    ip = run_compiled(*chunk, ip, regs, instruction);
+            }
+            VM_NEXT();
+
+            VM_CASE(RETURN_NIL)
+            {
+                const CallFrame& frame = frames.back();
+
+                if (frame.memoized != nullptr)
+                    remember(frame, Object());
+
+                while (stack.get_block_depth() > frame.blockDepth)
+                    stack.exit_block();
+
+                stack.exit_frame(frame.stackBase);
+                leave_loops(frames.size());
+
+                chunk = frame.chunk;
+                ip = frame.ip;
+                base = frame.base;
+                regs = registers.data() + base;
+                registers[frame.returnRegister] = Object();
+
+                frames.pop_back();
+
+                if (jitEnabled)
+                    ip = run_compiled(*chunk, ip, regs, instruction);
+            }
+            VM_NEXT();
+
+            VM_CASE(JUMP)
+            {
+                ip = chunk->code.data() + instruction->bx();
+
+                // only loops jump backwards
+                if (ip <= instruction && jitEnabled)
+                    ip = run_compiled(*chunk, ip, regs, instruction);
+            }
+            VM_NEXT();
+
+            VM_CASE(JUMP_IF_FALSE)
+            {
+                if (!regs[instruction->a].boolValue)
+                    ip = chunk->code.data() + instruction->bx();
+            }
+            VM_NEXT();
+
+            VM_CASE(JUMP_IF_ERROR)
+            {
+                if (hasErrors)
+                    ip = chunk->code.data() + instruction->bx();
+            }
+            VM_NEXT();
+
+            VM_CASE(ENTER_SCOPE)
+            {
+                stack.enter_block(*chunk->blocks[instruction->bx()]);
+            }
+            VM_NEXT();
+
+            VM_CASE(LEAVE_SCOPE)
+            {
+                for (unsigned int i = 0; i < instruction->a; ++i)
+                    stack.exit_block();
+            }
+            VM_NEXT();
+
+            VM_CASE(ENTER_LOOP)
+            {
+                enter_loop(chunk->loops[instruction->bx()]);
+            }
+            VM_NEXT();
+
+            VM_CASE(LEAVE_LOOP)
+            {
+                leave_loop();
+            }
+            VM_NEXT();
+
+            VM_CASE(LOAD_INVARIANT)
+            {
+                const InvariantSite& site = chunk->invariants[instruction->bx()];
+
+                if (load_invariant(site, regs[instruction->a]))
+                    ip = chunk->code.data() + site.skip;
+            }
+            VM_NEXT();
+
+            VM_CASE(STORE_INVARIANT)
+            {
+                store_invariant(chunk->invariants[instruction->bx()], regs[instruction->a]);
+            }
+            VM_NEXT();
+
+            VM_CASE(RAISE)
+            {
+                throw std::runtime_error(chunk->constants[instruction->bx()].as_string());
+            }
+            VM_NEXT();
+
+            VM_CASE(HALT)
+            {
+                return;
+            }
+#ifndef COMPUTED_GOTO
+            }
+            }
+#endif
+        }
+        catch (const std::exception& exp)
+        {
+            ip = raise(exp.what(), *chunk, instruction, regs);
+        }
+    }
+}
+
+/**
+ * Runs the compiled code of a chunk from an instruction on, once the
+ * chunk is hot. Returns the instruction the interpreter goes on with,
+ * which is the same one if the chunk is not compiled.
+ * A native that failed in compiled code is raised here as if the
+ * interpreter had called it.
+*/
+const Instruction* VirtualMachine::run_compiled(const Chunk& chunk, const Instruction* ip, Object* regs, const Instruction*& instruction)
+{
+    unsigned int chunkIndex = &chunk - program->chunks.data();
+    const void* entry = jit.entry(chunk, chunkIndex, ip - chunk.code.data());
+
+    if (entry == nullptr)
+        return ip;
+
+    std::string error;
+
+    JitContext context;
+    context.regs = regs;
+    context.locals = stack.frame();
+    context.hasErrors = &hasErrors;
+    context.vm = this;
+    context.chunk = &chunk;
+    context.error = &error;
+
+    const Instruction* next = jit.run(chunkIndex, context, entry);
+
+    if (!error.empty())
+    {
+        instruction = next;
+        throw std::runtime_error(error);
+    }
+
+    return next;
+}
+
+/**
+ * Reports an error raised by an instruction and
+ * returns the instruction where execution continues.
+*/
+const Instruction* VirtualMachine::raise(const std::string& message, const Chunk& chunk, const Instruction* ip, Object* regs)
+{
+    unsigned int siteIndex = chunk.sites[ip - chunk.code.data()];
+
+    if (siteIndex >= chunk.siteTable.size())
+        throw std::runtime_error(message);
+
+    const Site& site = chunk.siteTable[siteIndex];
+    report(message, *site.statement);
+
+    if (site.nilRegister >= 0)
+        regs[site.nilRegister] = Object();
+
+    return chunk.code.data() + site.resume;
+}
+
+/**
+ * Adds an error at the location of a statement.
+*/
+void VirtualMachine::report(const std::string& message, const Statement& statement)
+{
+    diagnostics->add_error(message, statement.lineColumn, statement.lineNumber);
+    hasErrors = true;
+}
+
+/**
+ * Finds the call an INVOKE belongs to, which
+ * is where a call that can not be made failed.
+*/
+const Statement* VirtualMachine::find_call(const Chunk& chunk, const Instruction* invoke) const
+{
+    unsigned int index = invoke - chunk.code.data();
+
+    for (auto& call : chunk.calls)
+    {
+        if (call.skip == index + 1)
+            return call.statement;
+    }
+
+    return chunk.siteTable[chunk.sites[index]].statement;
+}
+
+/**
+ * Puts the result of a returning memoized function into the memo cache,
+ * unless an error was reported while it ran.
+*/
+void VirtualMachine::remember(const CallFrame& frame, const Object& result)
+{
+    if (!hasErrors)
+        memo.insert(frame.memoized->function, memoArguments.data() + frame.memoBase, frame.memoized->parameterNames.size(), result);
+
+    memoArguments.resize(frame.memoBase);
+}
+
+/**
+ * Gives a loop a new stamp for the run that starts, its invariants
+ * are computed again the first time they come up.
+*/
+void VirtualMachine::enter_loop(SI_Loop* loop)
+{
+    loopRuns.push_back({ loop, loop->stamp, CAST(frames.size(), unsigned int) });
+    loop->stamp = ++SI_Loop::lastStamp;
+}
+
+/**
+ * Gives the loop entered last the stamp of its enclosing run back.
+*/
+void VirtualMachine::leave_loop()
+{
+    loopRuns.back().loop->stamp = loopRuns.back().enclosingStamp;
+    loopRuns.pop_back();
+}
+
+/**
+ * Leaves every loop run at or above a frame depth, for a frame that
+ * ends in the middle of its loops.
+*/
+void VirtualMachine::leave_loops(unsigned int depth)
+{
+    while (!loopRuns.empty() && loopRuns.back().depth >= depth)
+        leave_loop();
+}
+
+/**
+ * Gets the value of an invariant if it was computed under
+ * the current stamp of its loop.
+*/
+bool VirtualMachine::load_invariant(const InvariantSite& site, Object& value) const
+{
+    if (site.invariant->stamp != site.invariant->loop->stamp)
+        return false;
+
+    value = site.invariant->value;
+    return true;
+}
+
+/**
+ * Keeps the value of an invariant under the current stamp of its loop.
+*/
+void VirtualMachine::store_invariant(const InvariantSite& site, const Object& value)
+{
+    site.invariant->value = value;
+    site.invariant->stamp = site.invariant->loop->stamp;
+}
+
+#pragma endregion
+
+#pragma region Public Methods
+
+VirtualMachine::VirtualMachine() : stack(ownStack), memo(ownMemo)
+{
+}
+
+/**
+ * A virtual machine that runs on the stack and
+ * remembers results in the memo cache of someone else.
+*/
+VirtualMachine::VirtualMachine(Stack& stack, MemoCache& memo) : stack(stack), memo(memo)
+{
+}
+
+/**
+ * Runs a compiled program.
+*/
+void VirtualMachine::run(Program* program, Diagnostics* diagnostics)
+{
+    this->program = program;
+    this->diagnostics = diagnostics;
+    hasErrors = diagnostics->has_errors();
+
+    registers.clear();
+    registers.resize(program->chunks[0].registerCount + 1);
+    frames.clear();
+    memoArguments.clear();
+    memo.clear();
+    stack.reset();
+    jit.reset(program->chunks.size());
+
+    try
+    {
+        execute(0);
+    }
+    catch (const RecursionLimit& limit)
+    {
+        report("Maximum recursion depth exceeded!", *limit.functionCall);
+    }
+
+    leave_loops(0);
+}
+
+/**
+ * Runs a single chunk of a program on the stack as it is, with the
+ * arguments in the registers after the first. Returns the first register.
+ * Chunks compiled since the last run are picked up, compiled code is kept.
+ * A loop chunk can return from the function it was in, has_returned tells.
+*/
+Object VirtualMachine::run_chunk(Program* program, Diagnostics* diagnostics, unsigned int chunkIndex, const std::vector<Object>& arguments)
+{
+    this->program = program;
+    this->diagnostics = diagnostics;
+    hasErrors = diagnostics->has_errors();
+
+    if (registers.size() < program->chunks[chunkIndex].registerCount + 1)
+        registers.resize(program->chunks[chunkIndex].registerCount + 1);
+
+    for (unsigned int i = 0; i < arguments.size(); ++i)
+        registers[i + 1] = arguments[i];
+
+    frames.clear();
+    memoArguments.clear();
+    returned = false;
+    entryBlockDepth = stack.get_block_depth();
+    jit.grow(program->chunks.size());
+
+    // the loops left running give their stamps back to the walker
+    try
+    {
+        execute(chunkIndex);
+    }
+    catch (...)
+    {
+        leave_loops(0);
+        throw;
+    }
+
+    leave_loops(0);
+    return registers[0];
+}
+
+#pragma endregion
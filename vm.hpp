@@ -0,0 +1,92 @@
+#ifndef VIRTUAL_MACHINE
+#define VIRTUAL_MACHINE
+
+#include <vector>
+#include <string>
+
+#include "compiler.hpp"
+#include "runner.hpp"
+#include "jit.hpp"
+#include "memo.hpp"
+
+namespace pop
+{
+    /**
+     * The saved state of a caller while a function runs. A call
+     * of a pure function keeps its arguments from memoBase on
+     * until its result goes into the memo cache.
+    */
+    struct CallFrame
+    {
+        const Chunk* chunk;
+        const Instruction* ip;
+        unsigned int base;
+        unsigned int returnRegister;
+        unsigned int stackBase;
+        unsigned int blockDepth;
+        const Chunk* memoized;
+        unsigned int memoBase;
+    };
+
+    /**
+     * A run of a loop with invariants, with the stamp of the enclosing
+     * run of the same loop and the frame depth it runs at.
+    */
+    struct LoopRun
+    {
+        SI_Loop* loop;
+        unsigned int enclosingStamp;
+        unsigned int depth;
+    };
+
+    /**
+     * A register based virtual machine that
+     * executes the bytecode of the compiler.
+    */
+    class VirtualMachine
+    {
+        friend class Jit;
+
+        Program* program;
+        Diagnostics* diagnostics;
+        std::vector<Object> registers;
+        std::vector<CallFrame> frames;
+        std::vector<LoopRun> loopRuns;
+        Stack ownStack;
+        Stack& stack;
+        MemoCache ownMemo;
+        MemoCache& memo;
+        std::vector<Object> memoArguments;
+        bool hasErrors;
+        bool returned = false;
+        unsigned int entryBlockDepth = 0;
+        Jit jit;
+        bool jitEnabled = true;
+        unsigned int depthLimit = RecursionLimit::DEFAULT;
+
+        void execute(unsigned int chunkIndex);
+        const Instruction* run_compiled(const Chunk& chunk, const Instruction* ip, Object* regs, const Instruction*& instruction);
+        const Instruction* raise(const std::string& message, const Chunk& chunk, const Instruction* ip, Object* regs);
+        void report(const std::string& message, const Statement& statement);
+        const Statement* find_call(const Chunk& chunk, const Instruction* invoke) const;
+        void remember(const CallFrame& frame, const Object& result);
+        void enter_loop(SI_Loop* loop);
+        void leave_loop();
+        void leave_loops(unsigned int depth);
+        bool load_invariant(const InvariantSite& site, Object& value) const;
+        void store_invariant(const InvariantSite& site, const Object& value);
+
+    public:
+        VirtualMachine();
+        VirtualMachine(Stack& stack, MemoCache& memo);
+
+        void set_jit_enabled(bool enabled) { jitEnabled = enabled; }
+        void set_depth_limit(unsigned int limit) { depthLimit = limit; }
+        void set_memo_capacity(std::size_t bytes) { memo.set_capacity(bytes); }
+        void run(Program* program, Diagnostics* diagnostics);
+        Object run_chunk(Program* program, Diagnostics* diagnostics, unsigned int chunkIndex, const std::vector<Object>& arguments);
+        bool has_returned() const { return returned; }
+    };
+}
+
+#endif